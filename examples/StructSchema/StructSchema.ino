@@ -0,0 +1,90 @@
+/*
+ * Demonstrates reading and writing a structure using a schema that's
+ * declared once, at compile time, instead of a hand-written sequence of
+ * write and expect calls.
+ *
+ * Data structure, encoded as a map with integer keys:
+ * 1. Boolean flag
+ * 2. Unsigned 16-bit interval
+ * 3. Calibration: array of 3 floats
+ *
+ * Note that this is an example program that shows a few techniques for
+ * processing CBOR data and is not a complete program. This uses bytes
+ * instead of EEPROM so that it doesn't contribute to wearing down that
+ * memory.
+ *
+ * (c) 2017 Shawn Silverman
+ */
+
+#include <CBOR.h>
+#include <CBOR_streams.h>
+#include <CBOR_struct.h>
+
+namespace cbor = ::qindesign::cbor;
+
+// Settings contains important data.
+struct Settings {
+  bool flag = false;
+  uint16_t interval = 0;
+  float calibration[3]{0};
+};
+
+// Declare the fields once. The compiler generates the encoding and decoding
+// routines from this list.
+namespace qindesign {
+namespace cbor {
+template <>
+struct Schema<Settings> : MapSchema<
+    QINDESIGN_CBOR_FIELD(Settings, flag, 1),
+    QINDESIGN_CBOR_FIELD(Settings, interval, 2),
+    QINDESIGN_CBOR_FIELD(Settings, calibration, 3)> {};
+}  // namespace cbor
+}  // namespace qindesign
+
+uint8_t bytes[64]{0};
+
+void setup() {
+  // Standard serial initialization
+  Serial.begin(115200);
+  while (!Serial) {
+    ;
+  }
+  delay(2000);  // Wait for the serial monitor come up
+
+  Settings settings;
+  settings.flag = true;
+  settings.interval = 500;
+  settings.calibration[0] = 1.0f;
+  settings.calibration[1] = 0.5f;
+  settings.calibration[2] = -0.25f;
+
+  // Store
+  cbor::BytesPrint bp{bytes, sizeof(bytes)};
+  cbor::Writer w{bp};
+  w.writeTag(cbor::kSelfDescribeTag);
+  cbor::writeStruct(w, settings);
+  if (w.getWriteError() != 0) {
+    Serial.println("Buffer too small.");
+    return;
+  }
+  Serial.print("Wrote ");
+  Serial.print(w.getWriteSize());
+  Serial.println(" bytes.");
+
+  // Load
+  cbor::BufferReader r{bytes, bp.getIndex()};
+  Settings s2;
+  if (!expectValue(r, cbor::DataType::kTag, cbor::kSelfDescribeTag) ||
+      !cbor::readStruct(r, &s2)) {
+    Serial.println("Malformed structure. Something's wrong!");
+    return;
+  }
+  if (s2.flag == settings.flag && s2.interval == settings.interval &&
+      s2.calibration[2] == settings.calibration[2]) {
+    Serial.println("Everything matches!");
+  }
+}
+
+void loop() {
+  // Do stuff here
+}
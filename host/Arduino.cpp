@@ -0,0 +1,135 @@
+// Arduino.cpp is part of libCBOR.
+// (c) 2017 Shawn Silverman
+
+#include "Arduino.h"
+
+// C++ includes
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+// Project includes
+#include "EEPROM.h"
+
+HostSerial Serial;
+EEPROMClass EEPROM;
+
+// ***************************************************************************
+//  Time
+// ***************************************************************************
+
+// The time at program start.
+static const std::chrono::steady_clock::time_point kStartTime =
+    std::chrono::steady_clock::now();
+
+unsigned long millis() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now() - kStartTime)
+      .count();
+}
+
+unsigned long micros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - kStartTime)
+      .count();
+}
+
+void delay(unsigned long ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void yield() {
+  std::this_thread::yield();
+}
+
+// ***************************************************************************
+//  Print
+// ***************************************************************************
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t count = 0;
+  while (size-- > 0) {
+    if (write(*(buffer++)) == 0) {
+      break;
+    }
+    count++;
+  }
+  return count;
+}
+
+size_t Print::print(long n, int base) {
+  if (n < 0 && base == DEC) {
+    size_t count = print('-');
+    return count + printNumber(0UL - static_cast<unsigned long>(n), base);
+  }
+  return printNumber(static_cast<unsigned long>(n), base);
+}
+
+size_t Print::print(double d, int digits) {
+  char buf[64];
+  int n = snprintf(buf, sizeof(buf), "%.*f", (digits < 0) ? 0 : digits, d);
+  if (n < 0) {
+    return 0;
+  }
+  return write(buf, (static_cast<size_t>(n) < sizeof(buf)) ? n
+                                                           : sizeof(buf) - 1);
+}
+
+size_t Print::printNumber(unsigned long n, int base) {
+  if (base < 2) {
+    base = 10;
+  }
+  char buf[8 * sizeof(n)];
+  char *p = &buf[sizeof(buf)];
+  do {
+    int digit = n % base;
+    *(--p) = (digit < 10) ? '0' + digit : 'A' + digit - 10;
+    n /= base;
+  } while (n != 0);
+  return write(p, &buf[sizeof(buf)] - p);
+}
+
+// ***************************************************************************
+//  Stream
+// ***************************************************************************
+
+int Stream::timedRead() {
+  unsigned long start = millis();
+  do {
+    int c = read();
+    if (c >= 0) {
+      return c;
+    }
+    yield();
+  } while (millis() - start < timeout_);
+  return -1;
+}
+
+size_t Stream::readBytes(char *buffer, size_t length) {
+  size_t count = 0;
+  while (count < length) {
+    int c = timedRead();
+    if (c < 0) {
+      break;
+    }
+    *(buffer++) = static_cast<char>(c);
+    count++;
+  }
+  return count;
+}
+
+// ***************************************************************************
+//  HostSerial
+// ***************************************************************************
+
+size_t HostSerial::write(uint8_t b) {
+  return (fputc(b, stdout) == EOF) ? 0 : 1;
+}
+
+size_t HostSerial::write(const uint8_t *buffer, size_t size) {
+  return fwrite(buffer, 1, size, stdout);
+}
+
+void HostSerial::flush() {
+  fflush(stdout);
+}
@@ -0,0 +1,70 @@
+// Arduino.h is a minimal host implementation of the Arduino core API, for
+// building the library on platforms other than Arduino; for example, for
+// decoding data on a server or for profiling.
+// This is part of libCBOR.
+// (c) 2017 Shawn Silverman
+
+#ifndef CBOR_HOST_ARDUINO_H_
+#define CBOR_HOST_ARDUINO_H_
+
+// C++ includes
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Project includes
+#include "Print.h"
+#include "Stream.h"
+
+// Program memory is ordinary memory on a host.
+#define PROGMEM
+
+// Returns the number of milliseconds since the program started.
+unsigned long millis();
+
+// Returns the number of microseconds since the program started.
+unsigned long micros();
+
+// Waits for the given number of milliseconds.
+void delay(unsigned long ms);
+
+// Gives other threads a chance to run.
+void yield();
+
+// HostSerial is a Stream over the standard input and output.
+class HostSerial : public Stream {
+ public:
+  HostSerial() = default;
+  ~HostSerial() override = default;
+
+  // Does nothing. This is only here for compatibility.
+  void begin(unsigned long baud) {}
+
+  // The standard streams are always ready.
+  explicit operator bool() const {
+    return true;
+  }
+
+  // Reading isn't supported, so there's never anything available and
+  // read() and peek() always return -1.
+  int available() override {
+    return 0;
+  }
+  int read() override {
+    return -1;
+  }
+  int peek() override {
+    return -1;
+  }
+
+  size_t write(uint8_t b) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  void flush() override;
+
+  using Print::write;
+};
+
+extern HostSerial Serial;
+
+#endif  // CBOR_HOST_ARDUINO_H_
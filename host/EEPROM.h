@@ -0,0 +1,55 @@
+// EEPROM.h is a host implementation of the Arduino EEPROM library, backed
+// by memory.
+// This is part of libCBOR.
+// (c) 2017 Shawn Silverman
+
+#ifndef CBOR_HOST_EEPROM_H_
+#define CBOR_HOST_EEPROM_H_
+
+// C++ includes
+#include <cstdint>
+
+// The size of the simulated EEPROM.
+#ifndef QINDESIGN_CBOR_HOST_EEPROM_SIZE
+#define QINDESIGN_CBOR_HOST_EEPROM_SIZE 4096
+#endif
+
+// EEPROMClass simulates the EEPROM with an array. Out-of-range addresses
+// read as 0xff and are not written.
+class EEPROMClass {
+ public:
+  EEPROMClass() : data_{0} {}
+
+  uint8_t read(int address) const {
+    return inRange(address) ? data_[address] : 0xff;
+  }
+
+  void write(int address, uint8_t b) {
+    if (inRange(address)) {
+      data_[address] = b;
+    }
+  }
+
+  // Writes the byte only if it's different from the stored value.
+  void update(int address, uint8_t b) {
+    if (read(address) != b) {
+      write(address, b);
+    }
+  }
+
+  // Returns the size of the EEPROM.
+  int length() const {
+    return QINDESIGN_CBOR_HOST_EEPROM_SIZE;
+  }
+
+ private:
+  static bool inRange(int address) {
+    return 0 <= address && address < QINDESIGN_CBOR_HOST_EEPROM_SIZE;
+  }
+
+  uint8_t data_[QINDESIGN_CBOR_HOST_EEPROM_SIZE];
+};
+
+extern EEPROMClass EEPROM;
+
+#endif  // CBOR_HOST_EEPROM_H_
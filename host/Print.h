@@ -0,0 +1,108 @@
+// Print.h is a minimal host implementation of the Arduino Print class, for
+// building the library on platforms other than Arduino.
+// This is part of libCBOR.
+// (c) 2017 Shawn Silverman
+
+#ifndef CBOR_HOST_PRINT_H_
+#define CBOR_HOST_PRINT_H_
+
+// C++ includes
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Number bases for print().
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+// Print is the base class for anything that bytes can be written to. This
+// follows the Arduino API closely enough to compile the library and its
+// examples.
+class Print {
+ public:
+  Print() : writeError_(0) {}
+  virtual ~Print() = default;
+
+  // Returns the write error, or zero if there is none.
+  int getWriteError() {
+    return writeError_;
+  }
+
+  // Clears the write error.
+  void clearWriteError() {
+    setWriteError(0);
+  }
+
+  // Writes a single byte and returns the number of bytes written.
+  virtual size_t write(uint8_t b) = 0;
+
+  // Writes bytes and returns the number of bytes written. The default
+  // implementation writes them one at a time.
+  virtual size_t write(const uint8_t *buffer, size_t size);
+
+  size_t write(const char *buffer, size_t size) {
+    return write(reinterpret_cast<const uint8_t *>(buffer), size);
+  }
+
+  size_t write(const char *s) {
+    return (s == nullptr) ? 0 : write(s, strlen(s));
+  }
+
+  // Returns the number of bytes that can be written without blocking.
+  virtual int availableForWrite() {
+    return 0;
+  }
+
+  // Writes any buffered data.
+  virtual void flush() {}
+
+  size_t print(const char *s) {
+    return write(s);
+  }
+  size_t print(char c) {
+    return write(static_cast<uint8_t>(c));
+  }
+  size_t print(unsigned char n, int base = DEC) {
+    return printNumber(n, base);
+  }
+  size_t print(int n, int base = DEC) {
+    return print(static_cast<long>(n), base);
+  }
+  size_t print(unsigned int n, int base = DEC) {
+    return printNumber(n, base);
+  }
+  size_t print(long n, int base = DEC);
+  size_t print(unsigned long n, int base = DEC) {
+    return printNumber(n, base);
+  }
+  size_t print(double d, int digits = 2);
+
+  size_t println() {
+    return write("\r\n");
+  }
+  template <typename T>
+  size_t println(T v) {
+    size_t n = print(v);
+    return n + println();
+  }
+  template <typename T>
+  size_t println(T v, int format) {
+    size_t n = print(v, format);
+    return n + println();
+  }
+
+ protected:
+  void setWriteError(int err = 1) {
+    writeError_ = err;
+  }
+
+ private:
+  // Prints an unsigned number in the given base.
+  size_t printNumber(unsigned long n, int base);
+
+  int writeError_;
+};
+
+#endif  // CBOR_HOST_PRINT_H_
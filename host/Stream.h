@@ -0,0 +1,50 @@
+// Stream.h is a minimal host implementation of the Arduino Stream class.
+// This is part of libCBOR.
+// (c) 2017 Shawn Silverman
+
+#ifndef CBOR_HOST_STREAM_H_
+#define CBOR_HOST_STREAM_H_
+
+// C++ includes
+#include <cstddef>
+#include <cstdint>
+
+// Project includes
+#include "Print.h"
+
+// Stream is the base class for anything that bytes can be read from. As on
+// Arduino, readBytes() waits up to the timeout for each byte.
+class Stream : public Print {
+ public:
+  Stream() : timeout_(1000) {}
+  ~Stream() override = default;
+
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  // Sets the maximum number of milliseconds to wait for data in
+  // readBytes(). The default is 1000.
+  void setTimeout(unsigned long timeout) {
+    timeout_ = timeout;
+  }
+
+  unsigned long getTimeout() const {
+    return timeout_;
+  }
+
+  // Reads bytes until the given length has been read or a read times
+  // out. This returns the number of bytes read.
+  size_t readBytes(char *buffer, size_t length);
+  size_t readBytes(uint8_t *buffer, size_t length) {
+    return readBytes(reinterpret_cast<char *>(buffer), length);
+  }
+
+ protected:
+  // Reads a byte, waiting up to the timeout. This returns -1 on timeout.
+  int timedRead();
+
+  unsigned long timeout_;
+};
+
+#endif  // CBOR_HOST_STREAM_H_
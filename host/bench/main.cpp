@@ -0,0 +1,15 @@
+// main.cpp runs the Arduino-style benchmark program on a host.
+// This is part of libCBOR.
+// (c) 2017 Shawn Silverman
+
+// Other includes
+#include <Arduino.h>
+
+void setup();
+void loop();
+
+int main() {
+  setup();
+  Serial.flush();
+  return 0;
+}
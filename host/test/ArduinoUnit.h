@@ -0,0 +1,122 @@
+// ArduinoUnit.h is a minimal host implementation of the parts of the
+// ArduinoUnit testing API used by the tests.
+// This is part of libCBOR.
+// (c) 2017 Shawn Silverman
+
+#ifndef CBOR_HOST_ARDUINOUNIT_H_
+#define CBOR_HOST_ARDUINOUNIT_H_
+
+// C++ includes
+#include <cstdio>
+#include <cstring>
+
+// Test is a single registered test. Tests are declared with the test()
+// macro and run, in declaration order, by Test::run().
+class Test {
+ public:
+  Test(const char *name, void (*fn)(Test &))
+      : name_(name), fn_(fn), passed_(true), next_(nullptr) {
+    if (last() == nullptr) {
+      first() = this;
+    } else {
+      last()->next_ = this;
+    }
+    last() = this;
+  }
+
+  // Runs all the tests and prints a summary.
+  static void run() {
+    if (done()) {
+      return;
+    }
+    int count = 0;
+    int failed = 0;
+    for (Test *t = first(); t != nullptr; t = t->next_) {
+      t->fn_(*t);
+      count++;
+      if (!t->passed_) {
+        printf("Test %s failed.\n", t->name_);
+        failed++;
+      }
+    }
+    printf("Test summary: %d passed, %d failed, and 0 skipped, "
+           "out of %d test(s).\n",
+           count - failed, failed, count);
+    failedCount() = failed;
+    done() = true;
+  }
+
+  // Returns whether all the tests have been run.
+  static bool isDone() {
+    return done();
+  }
+
+  // Returns the number of failed tests.
+  static int getFailedCount() {
+    return failedCount();
+  }
+
+  // Records a failed assertion.
+  void fail(const char *file, int line, const char *expr) {
+    printf("Assertion failed: %s:%d: %s\n", file, line, expr);
+    passed_ = false;
+  }
+
+ private:
+  static Test *&first() {
+    static Test *t = nullptr;
+    return t;
+  }
+  static Test *&last() {
+    static Test *t = nullptr;
+    return t;
+  }
+  static bool &done() {
+    static bool b = false;
+    return b;
+  }
+  static int &failedCount() {
+    static int n = 0;
+    return n;
+  }
+
+  const char *name_;
+  void (*fn_)(Test &);
+  bool passed_;
+  Test *next_;
+};
+
+// Equality that compares C strings by their contents, as ArduinoUnit does.
+template <typename A, typename B>
+inline bool testEqual(const A &a, const B &b) {
+  return a == b;
+}
+inline bool testEqual(const char *a, const char *b) {
+  return strcmp(a, b) == 0;
+}
+inline bool testEqual(char *a, char *b) {
+  return strcmp(a, b) == 0;
+}
+
+#define test(name)                                        \
+  static void test_##name(Test &test_);                   \
+  static Test test_##name##_instance{#name, test_##name}; \
+  static void test_##name(Test &test_)
+
+#define assertTrue(x)                     \
+  do {                                    \
+    if (!(x)) {                           \
+      test_.fail(__FILE__, __LINE__, #x); \
+      return;                             \
+    }                                     \
+  } while (false)
+
+#define assertFalse(x) assertTrue(!(x))
+#define assertEqual(a, b) assertTrue(testEqual((a), (b)))
+#define assertNotEqual(a, b) assertTrue(!testEqual((a), (b)))
+#define assertLess(a, b) assertTrue((a) < (b))
+#define assertMore(a, b) assertTrue((a) > (b))
+#define assertLessOrEqual(a, b) assertTrue((a) <= (b))
+#define assertMoreOrEqual(a, b) assertTrue((a) >= (b))
+
+#endif  // CBOR_HOST_ARDUINOUNIT_H_
@@ -0,0 +1,18 @@
+// main.cpp runs the Arduino-style test program on a host.
+// This is part of libCBOR.
+// (c) 2017 Shawn Silverman
+
+// Other includes
+#include <Arduino.h>
+#include <ArduinoUnit.h>
+
+void setup();
+void loop();
+
+int main() {
+  setup();
+  while (!Test::isDone()) {
+    loop();
+  }
+  return (Test::getFailedCount() == 0) ? 0 : 1;
+}
@@ -23,18 +23,260 @@
 // Other includes
 #include <Arduino.h>
 
+// Project includes
+#include "CBOR_nesting.h"
+
 namespace qindesign {
 namespace cbor {
 
-// Major types
-constexpr int kUnsignedInt   = 0;
-constexpr int kNegativeInt   = 1;
-constexpr int kBytes         = 2;
-constexpr int kText          = 3;
-constexpr int kArray         = 4;
-constexpr int kMap           = 5;
-constexpr int kTag           = 6;
-constexpr int kSimpleOrFloat = 7;
+// Executes a statement only when statistics are enabled.
+#if QINDESIGN_CBOR_STATS
+#define CBOR_STAT(statement) statement
+#else
+#define CBOR_STAT(statement)
+#endif
+
+using namespace detail;
+
+// Loads a big-endian value having the given number of bytes.
+static inline uint64_t loadBigEndian(const uint8_t *p, int size) {
+  uint64_t v = 0;
+  for (int i = 0; i < size; i++) {
+    v = (v << 8) | p[i];
+  }
+  return v;
+}
+
+// Stores a value in big-endian order using the given number of bytes.
+static inline void storeBigEndian(uint8_t *p, uint64_t v, int size) {
+  for (int i = size; --i >= 0; ) {
+    p[i] = static_cast<uint8_t>(v);
+    v >>= 8;
+  }
+}
+
+// Converts IEEE 754 binary floating-point bits to a narrower format having
+// the given number of mantissa and exponent bits, but only if the value can
+// be represented exactly. This includes infinities and NaNs whose payloads
+// fit. This returns whether the conversion was possible.
+static bool narrowFloat(uint64_t bits, int fromBitsM, int fromBitsE,
+                        int toBitsM, int toBitsE, uint64_t *out) {
+  const int fromExpBias = (1 << (fromBitsE - 1)) - 1;
+  const int toExpBias = (1 << (toBitsE - 1)) - 1;
+  const int shift = fromBitsM - toBitsM;
+
+  uint64_t sign = (bits >> (fromBitsM + fromBitsE)) & 1;
+  int e = static_cast<int>(bits >> fromBitsM) & ((1 << fromBitsE) - 1);
+  uint64_t m = bits & ((1ULL << fromBitsM) - 1);
+
+  uint64_t toE;
+  uint64_t toM;
+  if (e == (1 << fromBitsE) - 1) {  // Infinity or NaN
+    if ((m & ((1ULL << shift) - 1)) != 0) {
+      return false;
+    }
+    toE = (1 << toBitsE) - 1;
+    toM = m >> shift;
+  } else if (e == 0) {  // Zero or subnormal
+    // Subnormals are always too small for a narrower format
+    if (m != 0) {
+      return false;
+    }
+    toE = 0;
+    toM = 0;
+  } else {
+    int exp = e - fromExpBias;
+    if (exp > toExpBias) {
+      return false;
+    }
+    if (exp >= 1 - toExpBias) {  // Normal
+      if ((m & ((1ULL << shift) - 1)) != 0) {
+        return false;
+      }
+      toE = exp + toExpBias;
+      toM = m >> shift;
+    } else {  // Subnormal in the narrower format
+      int s = shift + (1 - toExpBias - exp);
+      m |= 1ULL << fromBitsM;
+      if (s >= 64 || (m & ((1ULL << s) - 1)) != 0) {
+        return false;
+      }
+      toE = 0;
+      toM = m >> s;
+    }
+  }
+  *out = (sign << (toBitsM + toBitsE)) | (toE << toBitsM) | toM;
+  return true;
+}
+
+// Converts IEEE 754 binary floating-point bits to a wider format having the
+// given number of mantissa and exponent bits. This is always exact. It uses
+// only integer operations so that it's fast on systems without an FPU.
+static uint64_t widenFloat(uint64_t bits, int fromBitsM, int fromBitsE,
+                           int toBitsM, int toBitsE) {
+  const int fromExpBias = (1 << (fromBitsE - 1)) - 1;
+  const int toExpBias = (1 << (toBitsE - 1)) - 1;
+  const int shift = toBitsM - fromBitsM;
+
+  uint64_t sign = ((bits >> (fromBitsM + fromBitsE)) & 1) <<
+                  (toBitsM + toBitsE);
+  int e = static_cast<int>(bits >> fromBitsM) & ((1 << fromBitsE) - 1);
+  uint64_t m = bits & ((1ULL << fromBitsM) - 1);
+
+  if (e == (1 << fromBitsE) - 1) {  // Infinity or NaN, keeping any payload
+    return sign | (static_cast<uint64_t>((1 << toBitsE) - 1) << toBitsM) |
+           (m << shift);
+  }
+  if (e == 0) {
+    if (m == 0) {  // Zero
+      return sign;
+    }
+    // Subnormal: normalize, since it's a normal number in the wider format
+    e = 1;
+    while ((m & (1ULL << fromBitsM)) == 0) {
+      m <<= 1;
+      e--;
+    }
+    m &= (1ULL << fromBitsM) - 1;
+  }
+  return sign |
+         (static_cast<uint64_t>(e - fromExpBias + toExpBias) << toBitsM) |
+         (m << shift);
+}
+
+// Converts IEEE 754 half-precision bits to the bits of a wider format.
+static inline uint64_t widenHalf(uint16_t half, int toBitsM, int toBitsE) {
+  return widenFloat(half, 10, 5, toBitsM, toBitsE);
+}
+
+#if __SIZEOF_DOUBLE__ == 4
+// Converts IEEE 754 double-precision bits to single-precision bits, rounding
+// to the nearest value, with ties to even. Values too large become infinity,
+// and NaNs stay NaNs. This uses only integer operations.
+static uint32_t roundDoubleToSingle(uint64_t bits) {
+  uint32_t sign = static_cast<uint32_t>(bits >> 32) & 0x80000000UL;
+  int e = static_cast<int>(bits >> 52) & 0x7ff;
+  uint64_t m = bits & ((1ULL << 52) - 1);
+
+  if (e == 0x7ff) {  // Infinity or NaN, keeping the top of any payload
+    uint32_t toM = static_cast<uint32_t>(m >> 29);
+    if (m != 0 && toM == 0) {
+      toM = 1UL << 22;
+    }
+    return sign | 0x7f800000UL | toM;
+  }
+  if (e == 0) {  // Zero, or a subnormal that's too small for a float
+    return sign;
+  }
+
+  // The biased single-precision exponent
+  int exp = e - 1023 + 127;
+  if (exp >= 0xff) {
+    return sign | 0x7f800000UL;
+  }
+  m |= 1ULL << 52;
+  int shift = 52 - 23;
+  if (exp <= 0) {  // Subnormal in single precision
+    shift += 1 - exp;
+    exp = 1;
+    if (shift > 53) {
+      return sign;
+    }
+  }
+
+  uint64_t rem = m & ((1ULL << shift) - 1);
+  uint64_t half = 1ULL << (shift - 1);
+  uint32_t r = static_cast<uint32_t>(m >> shift);
+  if (rem > half || (rem == half && (r & 1) != 0)) {
+    r++;
+  }
+  // Adding the mantissa with its implicit bit carries into the exponent when
+  // rounding overflows, including up to infinity, and turns the largest
+  // subnormals into the smallest normal
+  return sign + (static_cast<uint32_t>(exp - 1) << 23) + r;
+}
+#endif  // __SIZEOF_DOUBLE__ == 4
+
+double doubleFromBits(uint64_t bits) {
+#if __SIZEOF_DOUBLE__ == 4
+  float f;
+  uint32_t single = roundDoubleToSingle(bits);
+  memcpy(&f, &single, 4);
+  return f;
+#else
+  double d;
+  memcpy(&d, &bits, 8);
+  return d;
+#endif  // __SIZEOF_DOUBLE__ == 4
+}
+
+uint64_t doubleToBits(double d) {
+#if __SIZEOF_DOUBLE__ == 4
+  float f = d;
+  uint32_t single;
+  memcpy(&single, &f, 4);
+  return widenFloat(single, 23, 8, 52, 11);
+#else
+  uint64_t bits;
+  memcpy(&bits, &d, 8);
+  return bits;
+#endif  // __SIZEOF_DOUBLE__ == 4
+}
+
+// Tag for a typed array of uint8_t elements that were clamped (RFC 8746).
+constexpr uint8_t kTypedArrayUInt8ClampedTag = 68;
+
+// Returns the RFC 8746 typed array tag for the given element properties. The
+// tag's bits are 010fsell: float, signed, little-endian, and the length code.
+// Floating-point elements are never marked as signed.
+static uint8_t typedArrayTag(bool isFloat, bool isSigned, size_t size,
+                             bool littleEndian) {
+  uint8_t ll;
+  if (isFloat) {
+    ll = (size == 2) ? 0 : (size == 4) ? 1 : (size == 8) ? 2 : 3;
+  } else {
+    ll = (size == 1) ? 0 : (size == 2) ? 1 : (size == 4) ? 2 : 3;
+  }
+  return 0x40 | (isFloat ? 0x10 : 0) | (isSigned ? 0x08 : 0) |
+         (littleEndian ? 0x04 : 0) | ll;
+}
+
+// Reverses the byte order of each element having the given size in the
+// given number of bytes.
+static void swapElementBytes(uint8_t *p, size_t size, size_t len) {
+  switch (size) {
+    case 2:
+      for (size_t i = 0; i + 2 <= len; i += 2) {
+        uint8_t b = p[i];
+        p[i] = p[i + 1];
+        p[i + 1] = b;
+      }
+      break;
+    case 4:
+      for (size_t i = 0; i + 4 <= len; i += 4) {
+        uint32_t v;
+        memcpy(&v, &p[i], 4);
+        v = __builtin_bswap32(v);
+        memcpy(&p[i], &v, 4);
+      }
+      break;
+    case 8:
+      for (size_t i = 0; i + 8 <= len; i += 8) {
+        uint64_t v;
+        memcpy(&v, &p[i], 8);
+        v = __builtin_bswap64(v);
+        memcpy(&p[i], &v, 8);
+      }
+      break;
+  }
+}
+
+float halfToFloat(uint16_t half) {
+  float f;
+  uint32_t bits = static_cast<uint32_t>(widenHalf(half, 23, 8));
+  memcpy(&f, &bits, 4);
+  return f;
+}
 
 // ***************************************************************************
 //  Reader
@@ -47,11 +289,12 @@ DataType Reader::readDataType() {
     value_ = 0;
     bytesAvailable_ = 0;
     syntaxError_ = SyntaxError::kNoError;
-    initialByte_ = read();
+    initialByte_ = readNext();
     if (initialByte_ < 0) {
       majorType_ = 0;
       addlInfo_ = 0;
       waitAvailable_ = 0;
+      CBOR_STAT(countDataType(DataType::kEOS));
       return DataType::kEOS;
     }
     majorType_ = static_cast<uint8_t>(initialByte_) >> 5;
@@ -83,6 +326,8 @@ DataType Reader::readDataType() {
       case 29:
       case 30:
         syntaxError_ = SyntaxError::kUnknownAdditionalInfo;
+        CBOR_STAT(countSyntaxError(syntaxError_));
+        CBOR_STAT(countDataType(DataType::kSyntaxError));
         return DataType::kSyntaxError;
       case 31:
         switch (majorType_) {
@@ -90,6 +335,8 @@ DataType Reader::readDataType() {
           case kNegativeInt:
           case kTag:
             syntaxError_ = SyntaxError::kNotAnIndefiniteType;
+            CBOR_STAT(countSyntaxError(syntaxError_));
+            CBOR_STAT(countDataType(DataType::kSyntaxError));
             return DataType::kSyntaxError;
           case kSimpleOrFloat:  // Floating-point numbers and simple data types
             // Always allow breaks
@@ -105,39 +352,49 @@ DataType Reader::readDataType() {
   // If we need to, wait for any available bytes
   if (state_ == State::kWaitAvailable) {
     if (available() < waitAvailable_) {
+      CBOR_STAT(stats_.waitStalls++);
+      CBOR_STAT(countDataType(DataType::kEOS));
       return DataType::kEOS;
     }
     state_ = State::kReadValue;
   }
 
   // Read the value from the stream
+  if (state_ == State::kReadValue && in_ == nullptr && waitAvailable_ > 0) {
+    // Buffer source: decode the value straight from memory; the size was
+    // already checked above
+    value_ = loadBigEndian(&buf_[bufIndex_], waitAvailable_);
+    bufIndex_ += waitAvailable_;
+    readSize_ += waitAvailable_;
+    state_ = State::kDetermineType;
+  }
   if (state_ == State::kReadValue) {
     switch (addlInfo_) {
       case 24:
-        value_ = read();
+        value_ = readNext();
         break;
       case 25:
         value_ =
-            (static_cast<uint16_t>(read()) << 8) |
-            (static_cast<uint16_t>(read()));
+            (static_cast<uint16_t>(readNext()) << 8) |
+            (static_cast<uint16_t>(readNext()));
         break;
       case 26:
         value_ =
-            (static_cast<uint32_t>(read()) << 24) |
-            (static_cast<uint32_t>(read()) << 16) |
-            (static_cast<uint32_t>(read()) << 8) |
-            (static_cast<uint32_t>(read()));
+            (static_cast<uint32_t>(readNext()) << 24) |
+            (static_cast<uint32_t>(readNext()) << 16) |
+            (static_cast<uint32_t>(readNext()) << 8) |
+            (static_cast<uint32_t>(readNext()));
         break;
       case 27:
         value_ =
-            (static_cast<uint64_t>(read()) << 56) |
-            (static_cast<uint64_t>(read()) << 48) |
-            (static_cast<uint64_t>(read()) << 40) |
-            (static_cast<uint64_t>(read()) << 32) |
-            (static_cast<uint64_t>(read()) << 24) |
-            (static_cast<uint64_t>(read()) << 16) |
-            (static_cast<uint64_t>(read()) << 8) |
-            (static_cast<uint64_t>(read()));
+            (static_cast<uint64_t>(readNext()) << 56) |
+            (static_cast<uint64_t>(readNext()) << 48) |
+            (static_cast<uint64_t>(readNext()) << 40) |
+            (static_cast<uint64_t>(readNext()) << 32) |
+            (static_cast<uint64_t>(readNext()) << 24) |
+            (static_cast<uint64_t>(readNext()) << 16) |
+            (static_cast<uint64_t>(readNext()) << 8) |
+            (static_cast<uint64_t>(readNext()));
         break;
       case 28:
       case 29:
@@ -160,6 +417,7 @@ DataType Reader::readDataType() {
       case kBytes:
       case kText:
         bytesAvailable_ = value_;
+        utf8Remaining_ = 0;
         break;
       case kSimpleOrFloat:
         switch (addlInfo_) {
@@ -173,9 +431,14 @@ DataType Reader::readDataType() {
         }
         break;
     }
+#if QINDESIGN_CBOR_STATS
+    return countDataType(getDataType());
+#else
     return getDataType();
+#endif
   }
 
+  CBOR_STAT(countDataType(DataType::kEOS));
   return DataType::kEOS;
 }
 
@@ -242,23 +505,317 @@ size_t Reader::readBytes(uint8_t *buffer, size_t length) {
   if (length > bytesAvailable_) {
     length = bytesAvailable_;
   }
-  size_t read = in_.readBytes(buffer, length);
+  size_t read;
+  if (in_ == nullptr) {
+    read = bufSize_ - bufIndex_;
+    if (read > length) {
+      read = length;
+    }
+    memcpy(buffer, &buf_[bufIndex_], read);
+    bufIndex_ += read;
+  } else {
+    read = in_->readBytes(buffer, length);
+  }
   readSize_ += read;
   bytesAvailable_ -= read;
+  if (validateUTF8_ && majorType_ == kText) {
+    checkUTF8(buffer, read);
+  }
   return read;
 }
 
+bool Reader::getBytesView(const uint8_t **data, size_t *length) {
+  if (in_ != nullptr) {
+    return false;
+  }
+  size_t n = bufSize_ - bufIndex_;
+  if (n > bytesAvailable_) {
+    n = bytesAvailable_;
+  }
+  *data = &buf_[bufIndex_];
+  *length = n;
+  bufIndex_ += n;
+  readSize_ += n;
+  bytesAvailable_ -= n;
+  if (validateUTF8_ && majorType_ == kText) {
+    checkUTF8(*data, n);
+  }
+  return true;
+}
+
+bool Reader::readTypedArray(bool isFloat, bool isSigned, void *data,
+                            size_t size, size_t maxN, size_t *n) {
+  if (readDataType() != DataType::kTag) {
+    return false;
+  }
+  uint64_t tag = getTag();
+  bool littleEndian;
+  if (tag == typedArrayTag(isFloat, isSigned, size, false) ||
+      (size == 1 && !isSigned && tag == kTypedArrayUInt8ClampedTag)) {
+    littleEndian = false;
+  } else if (size > 1 && tag == typedArrayTag(isFloat, isSigned, size, true)) {
+    littleEndian = true;
+  } else {
+    return false;
+  }
+
+  if (readDataType() != DataType::kBytes || isIndefiniteLength()) {
+    return false;
+  }
+  uint64_t len = getLength();
+  if (len % size != 0 || len / size > maxN) {
+    return false;
+  }
+
+  uint8_t *p = static_cast<uint8_t *>(data);
+  size_t remaining = static_cast<size_t>(len);
+  while (remaining > 0) {
+    size_t read = readBytes(p, remaining);
+    if (read == 0) {
+      return false;
+    }
+    p += read;
+    remaining -= read;
+  }
+  *n = static_cast<size_t>(len / size);
+  if (size > 1 && littleEndian != kLittleEndianHost) {
+    swapElementBytes(static_cast<uint8_t *>(data), size, *n * size);
+  }
+  return true;
+}
+
+// Returns whether an integer argument fits into an element having the given
+// size. For signed elements, negative integers have the same limit as
+// unsigned integers because the argument is -1 - value.
+static inline bool intFits(uint64_t v, size_t size, bool isSigned) {
+  if (size >= 8) {
+    return !isSigned || (v >> 63) == 0;
+  }
+  return v <= (uint64_t{1} << (size*8 - (isSigned ? 1 : 0))) - 1;
+}
+
+// Stores the low bytes of the given bits as element i of an integer array
+// having the given element size.
+static inline void storeInt(void *data, size_t i, size_t size,
+                            uint64_t bits) {
+  switch (size) {
+    case 1:
+      static_cast<uint8_t *>(data)[i] = static_cast<uint8_t>(bits);
+      break;
+    case 2:
+      static_cast<uint16_t *>(data)[i] = static_cast<uint16_t>(bits);
+      break;
+    case 4:
+      static_cast<uint32_t *>(data)[i] = static_cast<uint32_t>(bits);
+      break;
+    default:
+      static_cast<uint64_t *>(data)[i] = bits;
+      break;
+  }
+}
+
+bool Reader::readIntArray(bool isSigned, void *data, size_t size,
+                          size_t maxN, size_t *n) {
+  size_t i = 0;
+  while (i < maxN) {
+    if (in_ == nullptr && state_ == State::kStart) {
+      bool isBreak = false;
+      i = readBufferedInts(isSigned, data, size, i, maxN, &isBreak);
+      if (isBreak || i >= maxN) {
+        break;
+      }
+    }
+
+    // Anything the fast path didn't handle, including streams
+    DataType dt = readDataType();
+    if (dt == DataType::kBreak) {
+      break;
+    }
+    if ((dt != DataType::kUnsignedInt &&
+         (!isSigned || dt != DataType::kNegativeInt)) ||
+        !intFits(value_, size, isSigned)) {
+      *n = i;
+      return false;
+    }
+    storeInt(data, i++, size,
+             (dt == DataType::kNegativeInt) ? ~value_ : value_);
+  }
+  *n = i;
+  return true;
+}
+
+size_t Reader::readBufferedInts(bool isSigned, void *data, size_t size,
+                                size_t i, size_t maxN, bool *isBreak) {
+  const uint8_t *start = &buf_[bufIndex_];
+  const uint8_t *p = start;
+  const uint8_t *end = &buf_[bufSize_];
+  int last = -1;  // The last initial byte consumed
+  uint64_t v = 0;
+  while (i < maxN && p < end) {
+    uint8_t b = *p;
+    if (b == (kSimpleOrFloat << 5) + 31) {
+      p++;
+      last = b;
+      v = 0;
+      *isBreak = true;
+      CBOR_STAT(countDataType(DataType::kBreak));
+      break;
+    }
+
+    uint8_t mt = b >> 5;
+    uint8_t ai = b & 0x1f;
+    if ((mt != kUnsignedInt && (!isSigned || mt != kNegativeInt)) ||
+        ai >= 28) {
+      break;
+    }
+    int argSize = (ai < 24) ? 0 : 1 << (ai - 24);
+    if (end - p <= argSize) {
+      break;
+    }
+    uint64_t arg = (argSize == 0) ? ai : loadBigEndian(p + 1, argSize);
+    if (!intFits(arg, size, isSigned)) {
+      break;
+    }
+    storeInt(data, i++, size, (mt == kNegativeInt) ? ~arg : arg);
+    CBOR_STAT(countDataType((mt == kUnsignedInt) ? DataType::kUnsignedInt
+                                                 : DataType::kNegativeInt));
+    p += 1 + argSize;
+    last = b;
+    v = arg;
+  }
+
+  // Make the last item the current one, as if it had been read normally
+  if (last >= 0) {
+    initialByte_ = last;
+    majorType_ = static_cast<uint8_t>(last) >> 5;
+    addlInfo_ = last & 0x1f;
+    value_ = v;
+    syntaxError_ = SyntaxError::kNoError;
+    bytesAvailable_ = 0;
+    bufIndex_ += p - start;
+    readSize_ += p - start;
+  }
+  return i;
+}
+
+size_t Reader::skip(size_t length) {
+  if (bytesAvailable_ == 0) {
+    return 0;
+  }
+  if (length > bytesAvailable_) {
+    length = bytesAvailable_;
+  }
+  size_t skipped = skipBytes(length);
+  bytesAvailable_ -= skipped;
+  return skipped;
+}
+
+bool Reader::skipItem() {
+  if (bytesAvailable_ > 0) {
+    uint64_t skipped = skipBytes(bytesAvailable_);
+    bool eos = (skipped != bytesAvailable_);
+    bytesAvailable_ -= skipped;
+    if (eos) {
+      wellFormedError_ = WellFormedError::kEOS;
+      return false;
+    }
+  }
+  wellFormedError_ = checkWellFormed(kMaxDepth);
+  return wellFormedError_ == WellFormedError::kNoError;
+}
+
 int Reader::readByte() {
   if (bytesAvailable_ == 0) {
     return -1;
   }
-  int b = read();
+  int b = readNext();
   if (b >= 0) {
     bytesAvailable_--;
+    if (validateUTF8_ && majorType_ == kText) {
+      uint8_t u = b;
+      checkUTF8(&u, 1);
+    }
   }
   return b;
 }
 
+// The bytes of a machine word, used for checking several bytes at once.
+using Word = uintptr_t;
+constexpr Word kWordHighBits = ~Word{0} / 0xff * 0x80;
+
+void Reader::checkUTF8(const uint8_t *p, size_t n) {
+  if (syntaxError_ != SyntaxError::kNoError) {
+    return;
+  }
+
+  const uint8_t *end = p + n;
+  while (p < end) {
+    if (utf8Remaining_ == 0) {
+      // Skip ASCII a word at a time
+      while (end - p >= static_cast<ptrdiff_t>(sizeof(Word))) {
+        Word w;
+        memcpy(&w, p, sizeof(Word));
+        if ((w & kWordHighBits) != 0) {
+          break;
+        }
+        p += sizeof(Word);
+      }
+      if (p >= end) {
+        break;
+      }
+
+      uint8_t b = *(p++);
+      if (b < 0x80) {
+        continue;
+      }
+      utf8Min_ = 0x80;
+      utf8Max_ = 0xbf;
+      if (b < 0xc2) {
+        // Continuation bytes and overlong 2-byte sequences
+        syntaxError_ = SyntaxError::kInvalidUTF8;
+        CBOR_STAT(countSyntaxError(syntaxError_));
+        return;
+      } else if (b < 0xe0) {
+        utf8Remaining_ = 1;
+      } else if (b < 0xf0) {
+        utf8Remaining_ = 2;
+        if (b == 0xe0) {
+          utf8Min_ = 0xa0;  // Overlong
+        } else if (b == 0xed) {
+          utf8Max_ = 0x9f;  // Surrogates
+        }
+      } else if (b < 0xf5) {
+        utf8Remaining_ = 3;
+        if (b == 0xf0) {
+          utf8Min_ = 0x90;  // Overlong
+        } else if (b == 0xf4) {
+          utf8Max_ = 0x8f;  // Past U+10FFFF
+        }
+      } else {
+        syntaxError_ = SyntaxError::kInvalidUTF8;
+        CBOR_STAT(countSyntaxError(syntaxError_));
+        return;
+      }
+    } else {
+      uint8_t b = *(p++);
+      if (b < utf8Min_ || utf8Max_ < b) {
+        syntaxError_ = SyntaxError::kInvalidUTF8;
+        CBOR_STAT(countSyntaxError(syntaxError_));
+        return;
+      }
+      utf8Remaining_--;
+      utf8Min_ = 0x80;
+      utf8Max_ = 0xbf;
+    }
+  }
+
+  // Sequences can't span the end of the text or of a chunk
+  if (bytesAvailable_ == 0 && utf8Remaining_ != 0) {
+    syntaxError_ = SyntaxError::kInvalidUTF8;
+    CBOR_STAT(countSyntaxError(syntaxError_));
+  }
+}
+
 SyntaxError Reader::getSyntaxError() const {
   return syntaxError_;
 }
@@ -296,6 +853,18 @@ bool Reader::getBoolean() const {
 }
 
 float Reader::getFloat() const {
+  if (majorType_ == kSimpleOrFloat) {
+    // Avoid going through double for the narrower types
+    if (addlInfo_ == 25) {  // Half-precision
+      return halfToFloat(static_cast<uint16_t>(value_));
+    }
+    if (addlInfo_ == 26) {  // Single-precision
+      float f;
+      uint32_t bits = static_cast<uint32_t>(value_);
+      memcpy(&f, &bits, 4);
+      return f;
+    }
+  }
   return static_cast<float>(getDouble());
 }
 
@@ -307,28 +876,13 @@ double Reader::getDouble() const {
   }
 
   if (addlInfo_ == 25) {  // Half-precision
-    constexpr int kBitsM = 10;
-    constexpr int kBitsE = 5;
-    constexpr int kExpBias = (1 << (kBitsE - 1)) - 1;  // 15
-    uint16_t half = static_cast<uint16_t>(value_);
-    int e = (half >> kBitsM) & ((1 << kBitsE) - 1);
-    int m = half & ((1 << kBitsM) - 1);
-    double val;
-    if (e == 0) {
-      val = ldexp(m, 1 - kExpBias - kBitsM);
-    } else if (e != (1 << kBitsE) - 1) {
-      val = ldexp(m + (1 << kBitsM), e - kExpBias - kBitsM);
-    } else {
-      val = (m == 0) ? INFINITY : NAN;
-    }
-    double sign = (half & (1 << (kBitsM + kBitsE))) ? -1 : 1;
-    return copysign(val, sign);
+    return doubleFromBits(widenHalf(static_cast<uint16_t>(value_), 52, 11));
   }
 
   if (addlInfo_ == 26) {  // Single-precision
     float f;
     uint32_t bits = static_cast<uint32_t>(value_);
-    memcpy(&f, &bits, 4);  // TODO: Is the size always 4?
+    memcpy(&f, &bits, 4);
     return f;
     // constexpr int kBitsM = 23;
     // constexpr int kBitsE = 8;
@@ -354,9 +908,7 @@ double Reader::getDouble() const {
   }
 
   if (addlInfo_ == 27) {  // Double-precision
-    double val;
-    memcpy(&val, &value_, 8);  // TODO: Is the size always 8?
-    return val;
+    return doubleFromBits(value_);
     // constexpr int kBitsM = 52;
     // constexpr int kBitsE = 11;
     // constexpr int kExpBias = (1 << (kBitsE - 1)) - 1;  // 1023
@@ -446,193 +998,213 @@ bool Reader::isBreak() const {
 // ***************************************************************************
 
 bool Reader::isWellFormed() {
-  bool retval = (isWellFormed(read(), false) >= 0);
+  return isWellFormed(kMaxDepth);
+}
+
+bool Reader::isWellFormed(int maxDepth) {
+  wellFormedError_ = checkWellFormed(maxDepth);
 #if defined(ESP8266) || defined(ESP32)
   yield();
 #endif
-  return retval;
+  return wellFormedError_ == WellFormedError::kNoError;
 }
 
-int Reader::isWellFormed(int initialByte, bool breakable) {
-  if (initialByte < 0) {
-    return -1;
-  }
-  uint8_t majorType = static_cast<uint8_t>(initialByte) >> 5;
-  uint8_t ai = initialByte & 0x1f;  // Additional information
-  uint64_t val;
-  switch (ai) {
-    case 24:
-      if (available() < 1) {
-        return -1;
-      }
-      val = static_cast<uint8_t>(read());
-      // Simple types having a 1-byte value < 32 are invalid but
-      // technically well-formed, so don't do the following check:
-      // if (majorType == kSimpleOrFloat && val < 32) {
-      //   return -1;
-      // }
-      break;
-    case 25:
-      if (available() < 2) {
-        return -1;
-      }
-      val =
-          (static_cast<uint16_t>(read()) << 8) |
-          (static_cast<uint16_t>(read()));
-      break;
-    case 26:
-      if (available() < 4) {
-        return -1;
-      }
-      val =
-          (static_cast<uint32_t>(read()) << 24) |
-          (static_cast<uint32_t>(read()) << 16) |
-          (static_cast<uint32_t>(read()) << 8) |
-          (static_cast<uint32_t>(read()));
-      break;
-    case 27:
-      if (available() < 8) {
-        return -1;
-      }
-      val =
-          (static_cast<uint64_t>(read()) << 56) |
-          (static_cast<uint64_t>(read()) << 48) |
-          (static_cast<uint64_t>(read()) << 40) |
-          (static_cast<uint64_t>(read()) << 32) |
-          (static_cast<uint64_t>(read()) << 24) |
-          (static_cast<uint64_t>(read()) << 16) |
-          (static_cast<uint64_t>(read()) << 8) |
-          (static_cast<uint64_t>(read()));
-      break;
-    case 28: case 29: case 30:
-      return -1;
-    case 31:
-      return isIndefiniteWellFormed(majorType, breakable);
-    default:
-      val = ai;
+WellFormedError Reader::checkWellFormed(int maxDepth) {
+  if (maxDepth > kMaxDepth) {
+    maxDepth = kMaxDepth;
   }
 
-  switch (majorType) {
-    // No content for 0, 1, or 7
-    case 2:  // Byte string
-    case 3:  // Text string (UTF-8)
-      if (val <= UINT32_MAX) {
-        for (uint32_t i = 0, max = static_cast<uint32_t>(val); i < max; i++) {
-          if (read() < 0) {
-            return -1;
+  NestingStack stack;
+
+  while (true) {
+    int ib = readNext();  // Initial byte
+    if (ib < 0) {
+      return WellFormedError::kEOS;
+    }
+    uint8_t majorType = static_cast<uint8_t>(ib) >> 5;
+    uint8_t ai = ib & 0x1f;  // Additional information
+
+    if (ai == 31) {
+      switch (majorType) {
+        case kBytes:
+        case kText: {
+          WellFormedError err = skipIndefiniteString(majorType);
+          if (err != WellFormedError::kNoError) {
+            return err;
           }
+          break;
         }
-      } else {
-        for (uint64_t i = 0; i < val; i++) {
-          if (read() < 0) {
-            return -1;
+        case kArray:
+        case kMap:
+          if (!stack.begin(0, true, majorType == kMap, maxDepth)) {
+            return WellFormedError::kMaxDepthExceeded;
           }
-        }
+          CBOR_STAT(if (stack.depth() > stats_.maxDepth) {
+            stats_.maxDepth = stack.depth();
+          });
+          continue;
+        case kSimpleOrFloat:  // Break
+          if (!stack.endBreak()) {
+            return WellFormedError::kSyntaxError;
+          }
+          break;
+        default:
+          // Unsigned integer (0), Negative integer (1), Tag (6)
+          return WellFormedError::kSyntaxError;
       }
-      break;
-    case 5:  // Map
-      // Check for overflow
-      if (val != 0 && 2*val <= val) {
-        return -1;
+    } else {
+      if (ai >= 28) {
+        return WellFormedError::kSyntaxError;
+      }
+      uint64_t val;
+      if (!readArgument(ai, &val)) {
+        return WellFormedError::kEOS;
       }
-      val <<= 1;
-      // fallthrough
-    case 4:  // Array
-      if (val <= UINT32_MAX) {
-        for (uint32_t i = 0, max = static_cast<uint32_t>(val); i < max; i++) {
-          if (isWellFormed(read(), false) < 0) {
-            return -1;
+      switch (majorType) {
+        case kBytes:
+        case kText:
+          if (skipBytes(val) != val) {
+            return WellFormedError::kEOS;
           }
-        }
-      } else {
-        for (uint64_t i = 0; i < val; i++) {
-          if (isWellFormed(read(), false) < 0) {
-            return -1;
+          break;
+        case kMap:
+          if (!mapItemCount(val, &val)) {
+            return WellFormedError::kSyntaxError;
           }
-        }
-      }
-      break;
-    case 6:
-      if (isWellFormed(read(), false) < 0) {
-        return -1;
+          // fallthrough
+        case kArray:
+          if (val == 0) {
+            break;
+          }
+          if (!stack.begin(val, false, majorType == kMap, maxDepth)) {
+            return WellFormedError::kMaxDepthExceeded;
+          }
+          CBOR_STAT(if (stack.depth() > stats_.maxDepth) {
+            stats_.maxDepth = stack.depth();
+          });
+          continue;
+        case kTag:
+          // A tag applies to the next item, so it doesn't need any nesting
+          stack.setTagged(true);
+          continue;
+        default:
+          // Unsigned integer (0), Negative integer (1),
+          // Floating-point numbers and simple data types (7)
+          break;
       }
-      break;
-    default:
-      // Unsigned integer (0), Negative integer (1),
-      // Floating-point numbers and simple data types (7)
-      break;
+    }
+
+    // An item is complete, so count it against the enclosing containers
+    stack.endItem();
+    if (stack.depth() == 0) {
+      return WellFormedError::kNoError;
+    }
   }
-  return majorType;
 }
 
-int Reader::isIndefiniteWellFormed(uint8_t majorType, bool breakable) {
-  switch (majorType) {
-    case kBytes:
-    case kText:
-      while (true) {
-        int ib = read();  // Initial byte
-        if (ib < 0) {
-          return -1;
-        }
+WellFormedError Reader::skipIndefiniteString(uint8_t majorType) {
+  while (true) {
+    int ib = readNext();  // Initial byte
+    if (ib < 0) {
+      return WellFormedError::kEOS;
+    }
 
-        // The only case we allow the major type to not match is a break
-        if (ib == (kSimpleOrFloat << 5) + 31) {
-          break;
-        }
+    // The only case we allow the major type to not match is a break
+    if (ib == (kSimpleOrFloat << 5) + 31) {
+      return WellFormedError::kNoError;
+    }
 
-        // Now short-circuit to exit if the major type doesn't match
-        // or if there's a nested indefinite-length situation
-        uint8_t mt = static_cast<uint8_t>(ib) >> 5;  // Major type
-        if (mt != majorType || (ib & 0x1f) == 31) {
-          return -1;
-        }
+    // Each chunk must be a definite-length item having the same major type
+    uint8_t ai = ib & 0x1f;
+    if ((static_cast<uint8_t>(ib) >> 5) != majorType || ai >= 28) {
+      return WellFormedError::kSyntaxError;
+    }
+    uint64_t len;
+    if (!readArgument(ai, &len)) {
+      return WellFormedError::kEOS;
+    }
+    if (skipBytes(len) != len) {
+      return WellFormedError::kEOS;
+    }
+  }
+}
 
-        int t = isWellFormed(ib, true);
-        if (t == -2) {  // Break
-          // NOTE: This case shouldn't happen because of the Break check above
-          break;
-        }
-        if (t == -1) {  // Malformed
-          return -1;
-        }
-      }
+bool Reader::readArgument(uint8_t addlInfo, uint64_t *val) {
+  int size;
+  switch (addlInfo) {
+    case 24:
+      size = 1;
       break;
-    case kArray:
-      while (true) {
-        int t = isWellFormed(read(), true);
-        if (t == -2) {  // Break
-          break;
-        }
-        if (t == -1) {  // Malformed
-          return -1;
-        }
-      }
+    case 25:
+      size = 2;
       break;
-    case kMap:
-      while (true) {
-        int t = isWellFormed(read(), true);
-        if (t == -2) {  // Break
-          break;
-        }
-        if (t == -1) {  // Malformed
-          return -1;
-        }
-        if (isWellFormed(read(), false) < 0) {
-          return -1;
-        }
-      }
+    case 26:
+      size = 4;
+      break;
+    case 27:
+      size = 8;
       break;
-    case kSimpleOrFloat:  // Floating-point numbers and simple data types
-      if (breakable) {
-        return -2;
-      }
-      return -1;
     default:
-      // Unsigned integer (0), Negative integer (1), Tag (6)
-      return -1;
+      *val = addlInfo;
+      return true;
+  }
+  if (available() < size) {
+    return false;
   }
+  if (in_ == nullptr) {
+    *val = loadBigEndian(&buf_[bufIndex_], size);
+    bufIndex_ += size;
+    readSize_ += size;
+  } else {
+    uint64_t v = 0;
+    for (int i = 0; i < size; i++) {
+      v = (v << 8) | static_cast<uint8_t>(readNext());
+    }
+    *val = v;
+  }
+  return true;
+}
 
-  return majorType;
+uint64_t Reader::skipBytes(uint64_t n) {
+  if (in_ == nullptr) {
+    size_t rem = bufSize_ - bufIndex_;
+    if (n > rem) {
+      n = rem;
+    }
+    bufIndex_ += n;
+    readSize_ += n;
+    return n;
+  }
+
+  // Skip in chunks of whatever is available so that readBytes never has to
+  // wait for a timeout
+  uint8_t buf[32];
+  uint64_t count = 0;
+  while (count < n) {
+    int avail = in_->available();
+    if (avail <= 0) {
+      // Nothing's available, so read a single byte to detect end-of-stream
+      if (readNext() < 0) {
+        break;
+      }
+      count++;
+      continue;
+    }
+    size_t size = sizeof(buf);
+    if (static_cast<size_t>(avail) < size) {
+      size = avail;
+    }
+    if (n - count < size) {
+      size = n - count;
+    }
+    size_t read = in_->readBytes(buf, size);
+    readSize_ += read;
+    if (read == 0) {
+      break;
+    }
+    count += read;
+  }
+  return count;
 }
 
 // ***************************************************************************
@@ -640,19 +1212,18 @@ int Reader::isIndefiniteWellFormed(uint8_t majorType, bool breakable) {
 // ***************************************************************************
 
 void Writer::writeBoolean(bool b) {
+  CBOR_STAT(stats_.majorTypes[kSimpleOrFloat]++);
   write((kSimpleOrFloat << 5) + (b ? 21 : 20));
 }
 
 void Writer::writeFloat(float f) {
-  if (write((kSimpleOrFloat << 5) + 26) == 0) {
-    return;
-  }
+  uint8_t buf[5];
 
   // constexpr int kBitsM = 23;
   // constexpr int kBitsE = 8;
 
   uint32_t val;
-  memcpy(&val, &f, 4);  // TODO: Is the size always 4?
+  memcpy(&val, &f, 4);
   // if (std::isnan(f)) {
   //   memcpy(&val, &f, 4);  // TODO: Is the size always 4?
   // } else if (std::isinf(f)) {
@@ -680,28 +1251,27 @@ void Writer::writeFloat(float f) {
   //   val |= (1UL << 31);
   // }
 
-  if (write(val >> 24) == 0) {
+  CBOR_STAT(stats_.majorTypes[kSimpleOrFloat]++);
+  uint64_t half;
+  if (shortestFloats_ && narrowFloat(val, 23, 8, 10, 5, &half)) {
+    buf[0] = (kSimpleOrFloat << 5) + 25;
+    storeBigEndian(&buf[1], half, 2);
+    write(buf, 3);
     return;
   }
-  if (write(val >> 16) == 0) {
-    return;
-  }
-  if (write(val >> 8) == 0) {
-    return;
-  }
-  write(val);
+
+  buf[0] = (kSimpleOrFloat << 5) + 26;
+  storeBigEndian(&buf[1], val, 4);
+  write(buf, sizeof(buf));
 }
 
 void Writer::writeDouble(double d) {
-  if (write((kSimpleOrFloat << 5) + 27) == 0) {
-    return;
-  }
+  uint8_t buf[9];
 
   // constexpr int kBitsM = 52;
   // constexpr int kBitsE = 11;
 
-  uint64_t val;
-  memcpy(&val, &d, 8);  // TODO: Is the size always 8?
+  uint64_t val = doubleToBits(d);
   // if (std::isnan(d)) {
   //   memcpy(&val, &d, 8);  // TODO: Is the size always 8?
   // } else if (std::isinf(d)) {
@@ -729,28 +1299,19 @@ void Writer::writeDouble(double d) {
   //   val |= (1ULL << 63);
   // }
 
-  if (write(val >> 56) == 0) {
-    return;
-  }
-  if (write(val >> 48) == 0) {
-    return;
-  }
-  if (write(val >> 40) == 0) {
-    return;
-  }
-  if (write(val >> 32) == 0) {
-    return;
-  }
-  if (write(val >> 24) == 0) {
-    return;
-  }
-  if (write(val >> 16) == 0) {
-    return;
-  }
-  if (write(val >> 8) == 0) {
+  uint64_t single;
+  if (shortestFloats_ && narrowFloat(val, 52, 11, 23, 8, &single)) {
+    float f;
+    uint32_t bits = static_cast<uint32_t>(single);
+    memcpy(&f, &bits, 4);
+    writeFloat(f);
     return;
   }
-  write(val);
+
+  CBOR_STAT(stats_.majorTypes[kSimpleOrFloat]++);
+  buf[0] = (kSimpleOrFloat << 5) + 27;
+  storeBigEndian(&buf[1], val, 8);
+  write(buf, sizeof(buf));
 }
 
 void Writer::writeUnsignedInt(uint64_t u) {
@@ -765,80 +1326,49 @@ void Writer::writeInt(int64_t i) {
 }
 
 void Writer::writeTypedInt(uint8_t mt, uint64_t u) {
+  CBOR_STAT(stats_.majorTypes[mt >> 5]++);
   if (u < 24) {
     write(mt + u);
-  } else if (u < (1 << 8)) {
-    if (write(mt + 24) == 0) {
-      return;
-    }
-    write(u);
+    return;
+  }
+
+  // Assemble the whole head so that it's written with a single call
+  uint8_t buf[9];
+  int size;
+  if (u < (1 << 8)) {
+    buf[0] = mt + 24;
+    size = 1;
   } else if (u < (1UL << 16)) {
-    if (write(mt + 25) == 0) {
-      return;
-    }
-    if (write(u >> 8) == 0) {
-      return;
-    }
-    write(u);
+    buf[0] = mt + 25;
+    size = 2;
   } else if (u < (1ULL << 32)) {
-    if (write(mt + 26) == 0) {
-      return;
-    }
-    if (write(u >> 24) == 0) {
-      return;
-    }
-    if (write(u >> 16) == 0) {
-      return;
-    }
-    if (write(u >> 8) == 0) {
-      return;
-    }
-    write(u);
+    buf[0] = mt + 26;
+    size = 4;
   } else {
-    if (write(mt + 27) == 0) {
-      return;
-    }
-    if (write(u >> 56) == 0) {
-      return;
-    }
-    if (write(u >> 48) == 0) {
-      return;
-    }
-    if (write(u >> 40) == 0) {
-      return;
-    }
-    if (write(u >> 32) == 0) {
-      return;
-    }
-    if (write(u >> 24) == 0) {
-      return;
-    }
-    if (write(u >> 16) == 0) {
-      return;
-    }
-    if (write(u >> 8) == 0) {
-      return;
-    }
-    write(u);
+    buf[0] = mt + 27;
+    size = 8;
   }
+  storeBigEndian(&buf[1], u, size);
+  write(buf, size + 1);
 }
 
 void Writer::writeNull() {
+  CBOR_STAT(stats_.majorTypes[kSimpleOrFloat]++);
   write((kSimpleOrFloat << 5) + 22);
 }
 
 void Writer::writeUndefined() {
+  CBOR_STAT(stats_.majorTypes[kSimpleOrFloat]++);
   write((kSimpleOrFloat << 5) + 23);
 }
 
 void Writer::writeSimpleValue(uint8_t v) {
+  CBOR_STAT(stats_.majorTypes[kSimpleOrFloat]++);
   if (v < 24) {
     write((kSimpleOrFloat << 5) + v);
   } else {
-    if (write((kSimpleOrFloat << 5) + 24) == 0) {
-      return;
-    }
-    write(v);
+    uint8_t buf[2]{(kSimpleOrFloat << 5) + 24, v};
+    write(buf, sizeof(buf));
   }
 }
 
@@ -854,6 +1384,35 @@ void Writer::writeByte(uint8_t b) {
   write(b);
 }
 
+void Writer::writeTypedArray(bool isFloat, bool isSigned, const void *data,
+                             size_t size, size_t n, bool littleEndian) {
+  if (size == 1) {
+    littleEndian = false;
+  }
+  writeTag(typedArrayTag(isFloat, isSigned, size, littleEndian));
+  writeTypedInt(kBytes << 5, static_cast<uint64_t>(n) * size);
+
+  const uint8_t *p = static_cast<const uint8_t *>(data);
+  if (size == 1 || littleEndian == kLittleEndianHost) {
+    write(p, n * size);
+    return;
+  }
+
+  // Swap the elements in chunks
+  uint8_t buf[32];
+  const size_t chunkN = sizeof(buf) / size;
+  while (n > 0) {
+    size_t count = (n < chunkN) ? n : chunkN;
+    memcpy(buf, p, count * size);
+    swapElementBytes(buf, size, count * size);
+    if (write(buf, count * size) < count * size) {
+      return;
+    }
+    p += count * size;
+    n -= count;
+  }
+}
+
 void Writer::beginBytes(unsigned int length) {
   writeTypedInt(kBytes << 5, length);
 }
@@ -863,10 +1422,12 @@ void Writer::beginText(unsigned int length) {
 }
 
 void Writer::beginIndefiniteBytes() {
+  CBOR_STAT(stats_.majorTypes[kBytes]++);
   write((kBytes << 5) + 31);
 }
 
 void Writer::beginIndefiniteText() {
+  CBOR_STAT(stats_.majorTypes[kText]++);
   write((kText << 5) + 31);
 }
 
@@ -878,15 +1439,147 @@ void Writer::beginMap(unsigned int length) {
   writeTypedInt(kMap << 5, length);
 }
 
+// Returns the size of the data item at the start of the buffer, or zero if
+// it's not a complete well-formed item.
+static size_t encodedItemSize(const uint8_t *buf, size_t size) {
+  BufferReader r{buf, size};
+  return r.skipItem() ? r.getIndex() : 0;
+}
+
+// Reverses the bytes in the range [begin, end).
+static void reverseBytes(uint8_t *begin, uint8_t *end) {
+  while (begin < end) {
+    uint8_t b = *begin;
+    *(begin++) = *(--end);
+    *end = b;
+  }
+}
+
+// Compares two encoded keys bytewise. A key that's a prefix of the other
+// sorts first.
+static int compareEncoded(const uint8_t *a, size_t aLen,
+                          const uint8_t *b, size_t bLen) {
+  int c = memcmp(a, b, (aLen < bLen) ? aLen : bLen);
+  if (c != 0 || aLen == bLen) {
+    return c;
+  }
+  return (aLen < bLen) ? -1 : 1;
+}
+
+bool Writer::writeSortedMap(uint8_t *pairs, size_t length) {
+  // Insertion sort: move each pair in front of the first pair in the sorted
+  // prefix having a greater key, by rotating the bytes in between
+  size_t count = 0;
+  size_t pos = 0;
+  while (pos < length) {
+    size_t keySize = encodedItemSize(&pairs[pos], length - pos);
+    if (keySize == 0) {
+      return false;
+    }
+    size_t valueSize =
+        encodedItemSize(&pairs[pos + keySize], length - pos - keySize);
+    if (valueSize == 0) {
+      return false;
+    }
+    size_t end = pos + keySize + valueSize;
+
+    size_t insert = 0;
+    while (insert < pos) {
+      size_t k = encodedItemSize(&pairs[insert], pos - insert);
+      if (compareEncoded(&pairs[insert], k, &pairs[pos], keySize) > 0) {
+        break;
+      }
+      insert += k;
+      insert += encodedItemSize(&pairs[insert], pos - insert);
+    }
+    if (insert < pos) {
+      reverseBytes(&pairs[insert], &pairs[pos]);
+      reverseBytes(&pairs[pos], &pairs[end]);
+      reverseBytes(&pairs[insert], &pairs[end]);
+    }
+
+    pos = end;
+    count++;
+  }
+
+  writeTypedInt(kMap << 5, count);
+  write(pairs, length);
+  return true;
+}
+
+// Compares the encoded pairs starting at the two offsets by their keys. A
+// well-formed item can't be a prefix of a different one, so the first
+// difference, if the keys differ, is within both keys, and comparing up to
+// the end of the buffer is enough.
+static int comparePairs(const uint8_t *pairs, size_t length, size_t a,
+                        size_t b) {
+  return memcmp(&pairs[a], &pairs[b], length - ((a < b) ? b : a));
+}
+
+bool Writer::writeSortedMap(const uint8_t *pairs, size_t length,
+                            size_t *offsets, size_t maxPairs) {
+  // Delimit the pairs
+  size_t count = 0;
+  size_t pos = 0;
+  while (pos < length) {
+    if (count >= maxPairs) {
+      return false;
+    }
+    size_t keySize = encodedItemSize(&pairs[pos], length - pos);
+    if (keySize == 0) {
+      return false;
+    }
+    size_t valueSize =
+        encodedItemSize(&pairs[pos + keySize], length - pos - keySize);
+    if (valueSize == 0) {
+      return false;
+    }
+    offsets[count++] = pos;
+    pos += keySize + valueSize;
+  }
+
+  // Binary insertion sort, placing each pair after any having an equal key
+  for (size_t i = 1; i < count; i++) {
+    size_t off = offsets[i];
+    size_t lo = 0;
+    size_t hi = i;
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo)/2;
+      if (comparePairs(pairs, length, offsets[mid], off) > 0) {
+        hi = mid;
+      } else {
+        lo = mid + 1;
+      }
+    }
+    if (lo < i) {
+      memmove(&offsets[lo + 1], &offsets[lo], (i - lo)*sizeof(size_t));
+      offsets[lo] = off;
+    }
+  }
+
+  writeTypedInt(kMap << 5, count);
+  for (size_t i = 0; i < count; i++) {
+    // Each pair ends where its value ends
+    BufferReader r{&pairs[offsets[i]], length - offsets[i]};
+    r.skipItem();
+    r.skipItem();
+    write(&pairs[offsets[i]], r.getIndex());
+  }
+  return true;
+}
+
 void Writer::beginIndefiniteArray() {
+  CBOR_STAT(stats_.majorTypes[kArray]++);
   write((kArray << 5) + 31);
 }
 
 void Writer::beginIndefiniteMap() {
+  CBOR_STAT(stats_.majorTypes[kMap]++);
   write((kMap << 5) + 31);
 }
 
 void Writer::endIndefinite() {
+  CBOR_STAT(stats_.majorTypes[kSimpleOrFloat]++);
   write((kSimpleOrFloat << 5) + 31);
 }
 
@@ -6,6 +6,18 @@
 #ifndef QINDESIGN_CBOR_H_
 #define QINDESIGN_CBOR_H_
 
+// C++ includes
+#ifdef __has_include
+#if __has_include(<climits>)
+#include <climits>
+#else
+#include <limits.h>
+#endif
+#else
+#include <climits>
+#endif
+
+// Other includes
 #include <Print.h>
 #include <Stream.h>
 
@@ -15,6 +27,22 @@ namespace cbor {
 // Tag that can be used to self-describe a CBOR item.
 constexpr uint16_t kSelfDescribeTag = 55799;
 
+// The maximum array and map nesting depth allowed by the well-formedness
+// check. Each level uses 9 bytes of stack space while checking. The value can
+// be changed at compile time by defining QINDESIGN_CBOR_MAX_DEPTH.
+#ifndef QINDESIGN_CBOR_MAX_DEPTH
+#define QINDESIGN_CBOR_MAX_DEPTH 32
+#endif
+constexpr int kMaxDepth = QINDESIGN_CBOR_MAX_DEPTH;
+
+// Whether this system stores multi-byte values in little-endian order. Typed
+// arrays (RFC 8746) in this order can be copied without swapping any bytes.
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+constexpr bool kLittleEndianHost = false;
+#else
+constexpr bool kLittleEndianHost = true;
+#endif
+
 enum class DataType {
   kUnsignedInt,
   kNegativeInt,
@@ -39,6 +67,93 @@ enum class SyntaxError {
   kUnknownAdditionalInfo,
   kNotAnIndefiniteType,
   kBadSimpleValue,
+  kInvalidUTF8,  // Only reported when UTF-8 validation is enabled
+};
+
+// Reader and Writer can keep counters of what they've processed, for finding
+// out where the time goes and which data is unusual. This is enabled by
+// defining QINDESIGN_CBOR_STATS to 1. When disabled, the default, the
+// counters and the functions that access them don't exist and cost nothing.
+#ifndef QINDESIGN_CBOR_STATS
+#define QINDESIGN_CBOR_STATS 0
+#endif
+
+#if QINDESIGN_CBOR_STATS
+// Counters kept by a Reader. See Reader::getStats().
+struct ReaderStats {
+  static constexpr int kDataTypeCount =
+      static_cast<int>(DataType::kSyntaxError) + 1;
+  static constexpr int kSyntaxErrorCount =
+      static_cast<int>(SyntaxError::kInvalidUTF8) + 1;
+
+  // The number of results from readDataType(), indexed by DataType. This
+  // includes DataType::kEOS and DataType::kSyntaxError.
+  uint32_t dataTypes[kDataTypeCount];
+
+  // The number of times readDataType() returned DataType::kEOS because the
+  // rest of a data item's head wasn't available yet. These are also
+  // counted in dataTypes.
+  uint32_t waitStalls;
+
+  // The number of syntax errors, indexed by SyntaxError. This includes
+  // UTF-8 errors found while reading text.
+  uint32_t syntaxErrors[kSyntaxErrorCount];
+
+  // The deepest array and map nesting seen by isWellFormed() and
+  // skipItem().
+  int maxDepth;
+};
+
+// Counters kept by a Writer. See Writer::getStats().
+struct WriterStats {
+  // The number of data item heads written, indexed by major type. Breaks
+  // and the heads of indefinite-length items are included.
+  uint32_t majorTypes[8];
+};
+#endif  // QINDESIGN_CBOR_STATS
+
+// Returns the encoded size of a data item head having the given unsigned
+// value. This is the size of an unsigned integer or tag, and the size of
+// the head for bytes, text, arrays, and maps having the given length. This
+// mirrors what Writer produces and can be evaluated at compile time.
+constexpr size_t encodedHeadSize(uint64_t u) {
+  return (u < 24) ? 1
+       : (u < (1 << 8)) ? 2
+       : (u < (1UL << 16)) ? 3
+       : (u < (1ULL << 32)) ? 5
+       : 9;
+}
+
+// Returns the encoded size of a signed integer. This can be evaluated at
+// compile time.
+constexpr size_t encodedIntSize(int64_t i) {
+  return encodedHeadSize((i < 0) ? ~static_cast<uint64_t>(i)
+                                 : static_cast<uint64_t>(i));
+}
+
+// Encoded sizes of fixed-size items.
+constexpr size_t kEncodedFloatSize = 5;
+constexpr size_t kEncodedDoubleSize = 9;
+
+// Floats are converted by copying their bits to and from 32-bit integers.
+static_assert(sizeof(float) == 4, "float must be 32 bits");
+
+// Converts the bits of an IEEE 754 half-precision value to a float. This is
+// always exact and uses only integer operations.
+float halfToFloat(uint16_t half);
+
+// Converts between a double and the bits of an IEEE 754 double-precision
+// value. Where double is only 32 bits, for example, on AVR, values are
+// rounded through float using integer operations.
+double doubleFromBits(uint64_t bits);
+uint64_t doubleToBits(double d);
+
+// Reasons why a data item is not well-formed.
+enum class WellFormedError {
+  kNoError,
+  kEOS,               // End-of-stream was reached before the end of the item
+  kSyntaxError,       // The data is malformed
+  kMaxDepthExceeded,  // Arrays and maps are nested too deeply
 };
 
 // Reader provides a way to parse bytes in a CBOR-encoded stream. This
@@ -54,7 +169,10 @@ class Reader : public Stream {
  public:
   Reader(Stream &in)
       : state_(State::kStart),
-        in_(in),
+        in_(&in),
+        buf_(nullptr),
+        bufSize_(0),
+        bufIndex_(0),
         initialByte_(0),
         majorType_(0),
         addlInfo_(0),
@@ -62,7 +180,12 @@ class Reader : public Stream {
         value_(0),
         syntaxError_(SyntaxError::kNoError),
         bytesAvailable_(0),
-        readSize_(0) {}
+        validateUTF8_(false),
+        utf8Remaining_(0),
+        utf8Min_(0),
+        utf8Max_(0),
+        readSize_(0),
+        wellFormedError_(WellFormedError::kNoError) {}
   ~Reader() = default;
 
   // Returns any read error in the underlying Stream object. This will return
@@ -70,10 +193,11 @@ class Reader : public Stream {
   // error may have occurred if readBytes returns zero.
   int getReadError() {
 #if defined(TEENSYDUINO)
-    return in_.getReadError();
-#else
-    return 0;
+    if (in_ != nullptr) {
+      return in_->getReadError();
+    }
 #endif
+    return 0;
   }
 
   // Reads the data type of the next data item. This returns DataType::kEOS
@@ -119,6 +243,18 @@ class Reader : public Stream {
   // for this data item.
   size_t readBytes(uint8_t *buffer, size_t length);
 
+  // Gets the remaining bytes of the current bytes or text data item without
+  // copying them, and advances past them. This is only possible when reading
+  // from memory, for example with a BufferReader; for stream sources, this
+  // returns false and nothing is consumed. The data points into the source
+  // buffer and remains valid for as long as it does.
+  //
+  // As with readBytes(), the length will be less than bytesAvailable() if
+  // the end of the buffer is reached first, and it will be zero if there
+  // are no more bytes in the current data item. For indefinite-length bytes
+  // or text, this gets the contents of the current chunk.
+  bool getBytesView(const uint8_t **data, size_t *length);
+
   // Reads data for bytes or text. It is up to the caller to read the correct
   // number of bytes, and also to concatenate any definite-length portions
   // of an indefinite-length byte or text stream.
@@ -137,6 +273,120 @@ class Reader : public Stream {
   // for this data item.
   int readByte();
 
+  // Skips data for bytes or text. This is like readBytes, except that the
+  // bytes are discarded. For buffer sources, this just advances the index.
+  //
+  // This returns the number of bytes actually skipped, which will be less
+  // than length only if there are fewer bytes available in the current data
+  // item, or if the underlying stream has reached end-of-stream.
+  size_t skip(size_t length);
+
+  // Skips the next complete data item, including any nested items, tags,
+  // and indefinite-length chunks. Any unread bytes in the current Bytes or
+  // Text data item are skipped first. This should be called when the parser
+  // is between data items; that is, not after readDataType() has returned
+  // DataType::kEOS partway through an item.
+  //
+  // This returns whether the item was skipped successfully. If this returns
+  // false then the item was not well-formed or end-of-stream was reached,
+  // and getWellFormedError() will indicate why.
+  //
+  // Note that this can't skip the rest of an array, map, or tag whose head
+  // has already been read, for example, by readDataType() or by a failed
+  // expectation function; it skips the next item instead, which would be
+  // that container's first child.
+  //
+  // For example, this is useful for skipping map values for
+  // unrecognized keys:
+  //   if (r.readDataType() == DataType::kUnsignedInt &&
+  //       r.getUnsignedInt() != kWantedKey) {
+  //     r.skipItem();  // Skip the value
+  //   }
+  bool skipItem();
+
+  // Reads an RFC 8746 typed array into data, which has room for maxN
+  // elements, and stores the number of elements read in n. This reads both
+  // the tag and the byte string. Elements in either byte order are accepted:
+  // an array in the host's order is copied straight into data, and one in
+  // the other order is then byte-swapped in place. For uint8_t, the clamped
+  // array tag is also accepted.
+  //
+  // This returns false if the tag doesn't match the element type, if the
+  // byte string has an indefinite length or a length that isn't a multiple
+  // of the element size, if there are more than maxN elements, or if
+  // end-of-stream was reached. Like the expectation functions, this consumes
+  // whatever it has read up to the point of failure.
+  bool readTypedArray(uint8_t *data, size_t maxN, size_t *n) {
+    return readTypedArray(false, false, data, sizeof(*data), maxN, n);
+  }
+  bool readTypedArray(int8_t *data, size_t maxN, size_t *n) {
+    return readTypedArray(false, true, data, sizeof(*data), maxN, n);
+  }
+  bool readTypedArray(uint16_t *data, size_t maxN, size_t *n) {
+    return readTypedArray(false, false, data, sizeof(*data), maxN, n);
+  }
+  bool readTypedArray(int16_t *data, size_t maxN, size_t *n) {
+    return readTypedArray(false, true, data, sizeof(*data), maxN, n);
+  }
+  bool readTypedArray(uint32_t *data, size_t maxN, size_t *n) {
+    return readTypedArray(false, false, data, sizeof(*data), maxN, n);
+  }
+  bool readTypedArray(int32_t *data, size_t maxN, size_t *n) {
+    return readTypedArray(false, true, data, sizeof(*data), maxN, n);
+  }
+  bool readTypedArray(uint64_t *data, size_t maxN, size_t *n) {
+    return readTypedArray(false, false, data, sizeof(*data), maxN, n);
+  }
+  bool readTypedArray(int64_t *data, size_t maxN, size_t *n) {
+    return readTypedArray(false, true, data, sizeof(*data), maxN, n);
+  }
+  bool readTypedArray(float *data, size_t maxN, size_t *n) {
+    return readTypedArray(true, false, data, sizeof(*data), maxN, n);
+  }
+  bool readTypedArray(double *data, size_t maxN, size_t *n) {
+    return readTypedArray(true, false, data, sizeof(*data), maxN, n);
+  }
+
+  // Reads up to maxN consecutive integer data items into data, for example,
+  // the elements of an array whose head was just read, and stores the number
+  // of items read in n. Reading stops early at a break, which is consumed, so
+  // this also works for indefinite-length arrays. The unsigned versions
+  // accept only unsigned integers, and the signed versions accept both
+  // kinds. When reading from a buffer, the items are decoded straight from
+  // memory instead of one readDataType() call at a time.
+  //
+  // This returns false if an item is not an integer, if its value doesn't
+  // fit into the element type, or if end-of-stream was reached; n counts the
+  // items stored before that. getDataType() then indicates the kind of item
+  // that stopped the read; for an integer type, either the value didn't fit
+  // or end-of-stream was reached partway through it. Like the expectation
+  // functions, this consumes whatever it has read up to the point of
+  // failure.
+  bool readUIntArray(uint8_t *data, size_t maxN, size_t *n) {
+    return readIntArray(false, data, sizeof(*data), maxN, n);
+  }
+  bool readUIntArray(uint16_t *data, size_t maxN, size_t *n) {
+    return readIntArray(false, data, sizeof(*data), maxN, n);
+  }
+  bool readUIntArray(uint32_t *data, size_t maxN, size_t *n) {
+    return readIntArray(false, data, sizeof(*data), maxN, n);
+  }
+  bool readUIntArray(uint64_t *data, size_t maxN, size_t *n) {
+    return readIntArray(false, data, sizeof(*data), maxN, n);
+  }
+  bool readIntArray(int8_t *data, size_t maxN, size_t *n) {
+    return readIntArray(true, data, sizeof(*data), maxN, n);
+  }
+  bool readIntArray(int16_t *data, size_t maxN, size_t *n) {
+    return readIntArray(true, data, sizeof(*data), maxN, n);
+  }
+  bool readIntArray(int32_t *data, size_t maxN, size_t *n) {
+    return readIntArray(true, data, sizeof(*data), maxN, n);
+  }
+  bool readIntArray(int64_t *data, size_t maxN, size_t *n) {
+    return readIntArray(true, data, sizeof(*data), maxN, n);
+  }
+
   // Returns the number of bytes available for the current Bytes or Text
   // data item.
   uint64_t bytesAvailable() const {
@@ -144,9 +394,29 @@ class Reader : public Stream {
   }
 
   // Returns the syntax error value if readDataType() returned
-  // DataType::kSyntaxError.
+  // DataType::kSyntaxError, or SyntaxError::kInvalidUTF8 if UTF-8 validation
+  // is enabled and the text read so far is not valid.
   SyntaxError getSyntaxError() const;
 
+  // Enables or disables checking that text is valid UTF-8 as it's read with
+  // readBytes(), readByte(), or getBytesView(). The check happens in the
+  // same pass as the read, using a word-at-a-time fast path for ASCII, so
+  // the data doesn't need to be scanned again afterwards. Text that's
+  // skipped isn't checked. The default is disabled.
+  //
+  // When invalid text is found, getSyntaxError() returns
+  // SyntaxError::kInvalidUTF8 until the next data item is read. The bytes
+  // are still returned. Each chunk of indefinite-length text must be valid
+  // on its own, as RFC 8949 requires.
+  void setValidateUTF8(bool flag) {
+    validateUTF8_ = flag;
+  }
+
+  // Returns whether UTF-8 validation is enabled.
+  bool isValidatingUTF8() const {
+    return validateUTF8_;
+  }
+
   // Gets the raw value attached to the current data item. This will return
   // a length for bytes, text, arrays, and maps. For indefinite length data
   // items, this will return zero. For boolean, null, undefined, break, and
@@ -242,9 +512,14 @@ class Reader : public Stream {
 
   // Checks if the next data item is well-formed. This includes any nested
   // items and advances the stream. A data item is considered not well-formed
-  // if there are syntax errors or end-of-stream has been reached before
-  // processing all the data. Since this advances the stream, this works best
-  // with a stream that can be reset.
+  // if there are syntax errors, if end-of-stream has been reached before
+  // processing all the data, or if arrays and maps are nested deeper than
+  // kMaxDepth. Since this advances the stream, this works best with a stream
+  // that can be reset.
+  //
+  // The check is iterative and uses a bounded amount of stack space, no
+  // matter how deeply the input is nested. The reason for any failure can be
+  // retrieved with getWellFormedError().
   //
   // This calls yield() at the end of the function if the processor is
   // an ESP8266 or ESP32.
@@ -252,30 +527,58 @@ class Reader : public Stream {
   // This advances the read size. See getReadSize().
   bool isWellFormed();
 
+  // Checks if the next data item is well-formed, allowing arrays and maps to
+  // be nested up to the given depth. Values larger than kMaxDepth are reduced
+  // to kMaxDepth. A depth of zero allows only non-container items at the top
+  // level. Otherwise, this is the same as isWellFormed().
+  bool isWellFormed(int maxDepth);
+
+  // Returns the reason the last well-formedness check failed, or
+  // WellFormedError::kNoError if it succeeded.
+  WellFormedError getWellFormedError() const {
+    return wellFormedError_;
+  }
+
   // Gets the number of bytes read so far.
   size_t getReadSize() const {
     return readSize_;
   }
 
+#if QINDESIGN_CBOR_STATS
+  // Returns the counters. This is only available when QINDESIGN_CBOR_STATS
+  // is enabled.
+  const ReaderStats &getStats() const {
+    return stats_;
+  }
+
+  // Sets all the counters to zero.
+  void resetStats() {
+    stats_ = ReaderStats{};
+  }
+#endif  // QINDESIGN_CBOR_STATS
+
   // Returns the number of bytes available in the underlying stream. This
   // follows the same contract as Stream::available().
   int available() override {
-    return in_.available();
+    if (in_ == nullptr) {
+      size_t rem = bufSize_ - bufIndex_;
+      return (rem > INT_MAX) ? INT_MAX : static_cast<int>(rem);
+    }
+    return in_->available();
   }
 
   // Returns a byte and increments the read size if end-of-stream was
   // not reached. This follows the same contract as Stream::read().
   int read() override {
-    int b = in_.read();
-    if (b >= 0) {
-      readSize_++;
-    }
-    return b;
+    return readNext();
   }
 
   // Peeks at the next byte. This follows the same contract as Stream::peek().
   int peek() override {
-    return in_.peek();
+    if (in_ == nullptr) {
+      return (bufIndex_ < bufSize_) ? buf_[bufIndex_] : -1;
+    }
+    return in_->peek();
   }
 
   // Does nothing and returns zero. This is only here to satisfy the
@@ -288,7 +591,32 @@ class Reader : public Stream {
   void flush() final {
   }
 
+ protected:
+  // Creates a reader that decodes directly from a byte buffer instead of
+  // from a Stream. See BufferReader.
+  Reader(const uint8_t *b, size_t length)
+      : state_(State::kStart),
+        in_(nullptr),
+        buf_(b),
+        bufSize_((b == nullptr) ? 0 : length),
+        bufIndex_(0),
+        initialByte_(0),
+        majorType_(0),
+        addlInfo_(0),
+        waitAvailable_(0),
+        value_(0),
+        syntaxError_(SyntaxError::kNoError),
+        bytesAvailable_(0),
+        validateUTF8_(false),
+        utf8Remaining_(0),
+        utf8Min_(0),
+        utf8Max_(0),
+        readSize_(0),
+        wellFormedError_(WellFormedError::kNoError) {}
+
  private:
+  friend class BufferReader;
+
   enum class State {
     kStart,
     kAdditionalInfo,
@@ -297,23 +625,83 @@ class Reader : public Stream {
     kDetermineType,
   };
 
-  // Checks if a data item is well-formed. This returns the major type
-  // on success, -1 on error, and -2 on encountering a break value. The
-  // breakable parameter indicates whether we should allow the break value.
-  // If it's disallowed then this will return -1 if a break value is
-  // encountered. When first called, breakable should be set to false.
-  //
-  // The initialByte argument is the value of the next read.
-  int isWellFormed(int initialByte, bool breakable);
+  // Checks if the next data item is well-formed without recursing. Arrays
+  // and maps may be nested up to maxDepth levels.
+  WellFormedError checkWellFormed(int maxDepth);
+
+  // Skips the chunks of an indefinite-length bytes or text item, up to and
+  // including the terminating break. The initial byte has already been read.
+  WellFormedError skipIndefiniteString(uint8_t majorType);
+
+  // Reads the value that follows an initial byte having the given additional
+  // info, from 24 to 27. Smaller values are returned as-is. This returns
+  // false if there aren't enough bytes available.
+  bool readArgument(uint8_t addlInfo, uint64_t *val);
+
+  // Reads a typed array having the given element properties. See the public
+  // readTypedArray functions.
+  bool readTypedArray(bool isFloat, bool isSigned, void *data, size_t size,
+                      size_t maxN, size_t *n);
+
+  // Reads integers having the given element properties. See the public
+  // readUIntArray and readIntArray functions.
+  bool readIntArray(bool isSigned, void *data, size_t size, size_t maxN,
+                    size_t *n);
+
+  // Decodes integers straight from the buffer, starting at element i, and
+  // returns the index just past the last one decoded. This stops before
+  // anything other than a complete integer that fits, or after a break, in
+  // which case *isBreak is set.
+  size_t readBufferedInts(bool isSigned, void *data, size_t size, size_t i,
+                          size_t maxN, bool *isBreak);
+
+  // Skips the given number of bytes from the source, regardless of the
+  // current data item. This returns the number of bytes skipped, which will
+  // be less than n only if end-of-stream was reached.
+  uint64_t skipBytes(uint64_t n);
+
+  // Checks the given text bytes for valid UTF-8, continuing from the
+  // current state, and sets the syntax error if they're invalid.
+  void checkUTF8(const uint8_t *p, size_t n);
+
+#if QINDESIGN_CBOR_STATS
+  // Counts a readDataType() result and returns it.
+  DataType countDataType(DataType dt) {
+    stats_.dataTypes[static_cast<int>(dt)]++;
+    return dt;
+  }
 
-  // Checks if an indefinite-length item is well-formed. This returns the
-  // major type on success, -1 on error, and -2 on encountering a break
-  // value. The breakable parameter indicates whether we should allow the
-  // break value.
-  int isIndefiniteWellFormed(uint8_t majorType, bool breakable);
+  // Counts a syntax error.
+  void countSyntaxError(SyntaxError err) {
+    stats_.syntaxErrors[static_cast<int>(err)]++;
+  }
+#endif  // QINDESIGN_CBOR_STATS
+
+  // Reads the next byte from the source, either the buffer or the stream,
+  // and increments the read size. This returns -1 on end-of-stream. Using
+  // this internally avoids a virtual call per byte for buffer sources.
+  int readNext() {
+    if (in_ == nullptr) {
+      if (bufIndex_ >= bufSize_) {
+        return -1;
+      }
+      readSize_++;
+      return buf_[bufIndex_++];
+    }
+    int b = in_->read();
+    if (b >= 0) {
+      readSize_++;
+    }
+    return b;
+  }
 
   State state_;
-  Stream &in_;
+
+  // The source is either a stream or, if in_ is nullptr, a buffer
+  Stream *in_;
+  const uint8_t *buf_;
+  size_t bufSize_;
+  size_t bufIndex_;
 
   int initialByte_;
   uint8_t majorType_;
@@ -325,7 +713,60 @@ class Reader : public Stream {
   // Bytes remaining for readByte() or readBytes.
   uint64_t bytesAvailable_;
 
+  // UTF-8 validation state for the current text item
+  bool validateUTF8_;
+  uint8_t utf8Remaining_;  // Continuation bytes still expected
+  uint8_t utf8Min_;        // Range of the next continuation byte
+  uint8_t utf8Max_;
+
   size_t readSize_;
+
+  WellFormedError wellFormedError_;
+
+#if QINDESIGN_CBOR_STATS
+  ReaderStats stats_{};
+#endif
+};
+
+// BufferReader is a Reader that decodes directly from a byte buffer that's
+// already in memory. It has the same API as Reader, but doesn't make any
+// virtual Stream calls to retrieve bytes; everything is read straight from
+// the buffer, with only bounds checks.
+//
+// The buffer must remain valid for the lifetime of this object.
+class BufferReader : public Reader {
+ public:
+  // Creates a new reader for a buffer. A null buffer is treated as being
+  // empty.
+  BufferReader(const uint8_t *b, size_t length) : Reader(b, length) {}
+
+  ~BufferReader() = default;
+
+  // Resets the reader back to the beginning of the buffer. This does not
+  // reset the read size.
+  void reset() {
+    seek(0);
+  }
+
+  // Moves the reader to the given index in the buffer. The next data item
+  // will be read from that position. Indexes past the end of the buffer are
+  // treated as the end. This does not change the read size.
+  void seek(size_t index) {
+    bufIndex_ = (index < bufSize_) ? index : bufSize_;
+    state_ = State::kStart;
+    bytesAvailable_ = 0;
+  }
+
+  // Returns the current index into the buffer. This indicates how many
+  // bytes were consumed since the start or since the last reset().
+  size_t getIndex() const {
+    return bufIndex_;
+  }
+
+  // Returns the buffer size.
+  size_t size() const {
+    return bufSize_;
+  }
 };
 
 // Writer provides a way to encode data to a CBOR-encoded stream. Callers
@@ -338,7 +779,8 @@ class Writer : public Print {
  public:
   Writer(Print &out)
       : out_(out),
-        writeSize_(0) {}
+        writeSize_(0),
+        shortestFloats_(false) {}
 
   ~Writer() = default;
 
@@ -348,6 +790,25 @@ class Writer : public Print {
     return out_.getWriteError();
   }
 
+  // Sets whether floating-point values are written using the shortest
+  // encoding that represents them exactly: half, single, or double
+  // precision. This is the "preferred serialization" from RFC 8949. The
+  // default is false, meaning writeFloat always writes single precision and
+  // writeDouble always writes double precision.
+  //
+  // Note that when this is enabled, readers must accept any precision; for
+  // example, expectDouble() only matches double-precision values, but
+  // Reader::getDouble() returns the exact value for all of them.
+  void setShortestFloats(bool flag) {
+    shortestFloats_ = flag;
+  }
+
+  // Returns whether floating-point values are written using the shortest
+  // exact encoding. See setShortestFloats(bool).
+  bool isShortestFloats() const {
+    return shortestFloats_;
+  }
+
   void writeBoolean(bool b);
   void writeFloat(float f);
   void writeDouble(double d);
@@ -358,6 +819,50 @@ class Writer : public Print {
   void writeSimpleValue(uint8_t v);
   void writeTag(uint64_t v);
 
+  // Writes an RFC 8746 typed array: a tag followed by a byte string holding
+  // all n elements. The elements are written in little-endian order if
+  // littleEndian is true and in big-endian order otherwise. When this
+  // matches the host's order, the default, the elements are copied straight
+  // out of data with a single write.
+  void writeTypedArray(const uint8_t *data, size_t n) {
+    writeTypedArray(false, false, data, sizeof(*data), n, false);
+  }
+  void writeTypedArray(const int8_t *data, size_t n) {
+    writeTypedArray(false, true, data, sizeof(*data), n, false);
+  }
+  void writeTypedArray(const uint16_t *data, size_t n,
+                       bool littleEndian = kLittleEndianHost) {
+    writeTypedArray(false, false, data, sizeof(*data), n, littleEndian);
+  }
+  void writeTypedArray(const int16_t *data, size_t n,
+                       bool littleEndian = kLittleEndianHost) {
+    writeTypedArray(false, true, data, sizeof(*data), n, littleEndian);
+  }
+  void writeTypedArray(const uint32_t *data, size_t n,
+                       bool littleEndian = kLittleEndianHost) {
+    writeTypedArray(false, false, data, sizeof(*data), n, littleEndian);
+  }
+  void writeTypedArray(const int32_t *data, size_t n,
+                       bool littleEndian = kLittleEndianHost) {
+    writeTypedArray(false, true, data, sizeof(*data), n, littleEndian);
+  }
+  void writeTypedArray(const uint64_t *data, size_t n,
+                       bool littleEndian = kLittleEndianHost) {
+    writeTypedArray(false, false, data, sizeof(*data), n, littleEndian);
+  }
+  void writeTypedArray(const int64_t *data, size_t n,
+                       bool littleEndian = kLittleEndianHost) {
+    writeTypedArray(false, true, data, sizeof(*data), n, littleEndian);
+  }
+  void writeTypedArray(const float *data, size_t n,
+                       bool littleEndian = kLittleEndianHost) {
+    writeTypedArray(true, false, data, sizeof(*data), n, littleEndian);
+  }
+  void writeTypedArray(const double *data, size_t n,
+                       bool littleEndian = kLittleEndianHost) {
+    writeTypedArray(true, false, data, sizeof(*data), n, littleEndian);
+  }
+
   // Writes bytes to the output. This must be preceded by a call to
   // beginBytes, beginIndefiniteBytes, beginText, or beginIndefiniteText.
   // endIndefinite must be called when finished writing bytes preceded by
@@ -408,6 +913,39 @@ class Writer : public Print {
   // to write the correct number of key/value pairs.
   void beginMap(unsigned int length);
 
+  // Writes a definite-length map whose pairs are sorted by the bytes of
+  // their encoded keys, for deterministic encoding as described in RFC 8949.
+  // The pairs must already be encoded, one after the other, in the given
+  // buffer; for example, by a Writer over a BytesPrint. They're sorted in
+  // place, without any allocation, and so the buffer is modified. Nested
+  // maps can be sorted by writing them with this function into the buffer of
+  // the enclosing map.
+  //
+  // This is an insertion sort that finds each pair's place by re-parsing
+  // the sorted pairs in front of it, so both the parsing and the moving of
+  // bytes take time proportional to the square of the number of pairs. It's
+  // best suited to small maps; for larger ones, use the version that takes
+  // an offsets array.
+  //
+  // Integer and length heads are always written in their shortest form. To
+  // produce fully deterministic data, also enable setShortestFloats(true)
+  // and avoid indefinite lengths.
+  //
+  // This returns false, and writes nothing, if the buffer doesn't contain
+  // a whole number of well-formed pairs.
+  bool writeSortedMap(uint8_t *pairs, size_t length);
+
+  // Writes a sorted map like writeSortedMap(pairs, length), but uses the
+  // given array, which has room for maxPairs offsets, to record where each
+  // pair starts. The pairs are delimited in a single pass, the offsets are
+  // sorted with a binary insertion sort, taking O(n log n) key comparisons,
+  // and then the pairs are written in order, so the buffer isn't modified.
+  //
+  // This returns false, and writes nothing, if the buffer doesn't contain
+  // a whole number of well-formed pairs or if there are more than maxPairs.
+  bool writeSortedMap(const uint8_t *pairs, size_t length, size_t *offsets,
+                      size_t maxPairs);
+
   // Starts an array having no specific length. It is up to the caller to
   // call endIndefinite after the correct number of elements has been written.
   //
@@ -431,6 +969,19 @@ class Writer : public Print {
     return writeSize_;
   }
 
+#if QINDESIGN_CBOR_STATS
+  // Returns the counters. This is only available when QINDESIGN_CBOR_STATS
+  // is enabled.
+  const WriterStats &getStats() const {
+    return stats_;
+  }
+
+  // Sets all the counters to zero.
+  void resetStats() {
+    stats_ = WriterStats{};
+  }
+#endif  // QINDESIGN_CBOR_STATS
+
   // Writes a byte and returns 1 if the write was successful, and zero
   // otherwise. This follows the same contract as Print::write(uint8_t).
   //
@@ -473,9 +1024,19 @@ class Writer : public Print {
   // or 0x00 (unsigned).
   void writeTypedInt(uint8_t mt, uint64_t u);
 
+  // Writes a typed array having the given element properties. See the public
+  // writeTypedArray functions.
+  void writeTypedArray(bool isFloat, bool isSigned, const void *data,
+                       size_t size, size_t n, bool littleEndian);
+
   Print &out_;
 
   size_t writeSize_;
+  bool shortestFloats_;
+
+#if QINDESIGN_CBOR_STATS
+  WriterStats stats_{};
+#endif
 };
 
 }  // namespace cbor
@@ -0,0 +1,504 @@
+// CBOR_document.cpp is part of libCBOR.
+// (c) 2017 Shawn Silverman
+
+#include "CBOR_document.h"
+
+// C++ includes
+#ifdef __has_include
+#if __has_include(<cstring>)
+#include <cstring>
+#else
+#include <string.h>
+#endif
+#else
+#include <cstring>
+#endif
+
+// Project includes
+#include "CBOR_nesting.h"
+
+namespace qindesign {
+namespace cbor {
+
+constexpr uint32_t Document::kNoNode;
+
+using detail::NestingStack;
+
+bool Document::parse(const uint8_t *data, size_t size, int maxDepth) {
+  size_ = 0;
+  data_ = data;
+  parsedSize_ = 0;
+  error_ = WellFormedError::kNoError;
+  full_ = false;
+
+  if (maxDepth > kMaxDepth) {
+    maxDepth = kMaxDepth;
+  }
+
+  BufferReader r{data, size};
+
+  // The nodes of the open containers and tags. Tags are tracked as
+  // containers having one child.
+  uint32_t open[kMaxDepth];
+  NestingStack stack;
+
+  while (true) {
+    DataType dt = r.readDataType();
+    uint32_t index = static_cast<uint32_t>(size_);
+    switch (dt) {
+      case DataType::kUnsignedInt:
+      case DataType::kNegativeInt:
+        if (!addNode(dt, r.getRawValue(), 0, false)) {
+          return false;
+        }
+        break;
+
+      case DataType::kBytes:
+      case DataType::kText:
+        if (!r.isIndefiniteLength()) {
+          uint64_t len = r.getLength();
+          if (len > size - r.getIndex()) {
+            return fail(WellFormedError::kEOS);
+          }
+          if (!fitsNode(len) ||
+              !addNode(dt, r.getIndex(), static_cast<uint32_t>(len), false)) {
+            return false;
+          }
+          if (r.skip(static_cast<size_t>(len)) != len) {
+            return fail(WellFormedError::kEOS);
+          }
+          break;
+        }
+
+        // Indefinite-length strings have a child for each non-empty chunk
+        if (!addNode(dt, 0, 0, true)) {
+          return false;
+        }
+        while (true) {
+          DataType chunk = r.readDataType();
+          if (chunk == DataType::kBreak) {
+            break;
+          }
+          if (chunk == DataType::kEOS) {
+            return fail(WellFormedError::kEOS);
+          }
+          if (chunk != dt || r.isIndefiniteLength()) {
+            return fail(WellFormedError::kSyntaxError);
+          }
+          uint64_t len = r.getLength();
+          if (len == 0) {
+            continue;
+          }
+          if (len > size - r.getIndex()) {
+            return fail(WellFormedError::kEOS);
+          }
+          if (!fitsNode(len) ||
+              !addNode(dt, r.getIndex(), static_cast<uint32_t>(len), false)) {
+            return false;
+          }
+          nodes_[index].length++;
+          if (r.skip(static_cast<size_t>(len)) != len) {
+            return fail(WellFormedError::kEOS);
+          }
+        }
+        nodes_[index].next = static_cast<uint32_t>(size_);
+        break;
+
+      case DataType::kArray:
+      case DataType::kMap: {
+        bool indefinite = r.isIndefiniteLength();
+        uint64_t count = indefinite ? 0 : r.getLength();
+        if (dt == DataType::kMap && !detail::mapItemCount(count, &count)) {
+          return fail(WellFormedError::kSyntaxError);
+        }
+        // Each child takes at least one byte
+        if (count > size - r.getIndex()) {
+          return fail(WellFormedError::kEOS);
+        }
+        if (!fitsNode(count) ||
+            !addNode(dt, 0, static_cast<uint32_t>(count), indefinite)) {
+          return false;
+        }
+        if (!indefinite && count == 0) {
+          break;
+        }
+        if (!stack.begin(count, indefinite, dt == DataType::kMap, maxDepth)) {
+          return fail(WellFormedError::kMaxDepthExceeded);
+        }
+        open[stack.depth() - 1] = index;
+        continue;
+      }
+
+      case DataType::kTag:
+        if (!addNode(dt, r.getTag(), 1, false)) {
+          return false;
+        }
+        if (!stack.begin(1, false, false, maxDepth)) {
+          return fail(WellFormedError::kMaxDepthExceeded);
+        }
+        open[stack.depth() - 1] = index;
+        continue;
+
+      case DataType::kBoolean:
+      case DataType::kNull:
+      case DataType::kUndefined:
+        if (!addNode(dt, r.getBoolean() ? 1 : 0, 0, false)) {
+          return false;
+        }
+        break;
+      case DataType::kSimpleValue:
+        if (!addNode(dt, r.getSimpleValue(), 0, false)) {
+          return false;
+        }
+        break;
+      case DataType::kFloat:
+      case DataType::kDouble: {
+        double d = r.getDouble();
+        uint64_t bits = 0;
+        memcpy(&bits, &d, sizeof(d));
+        if (!addNode(dt, bits, 0, false)) {
+          return false;
+        }
+        break;
+      }
+
+      case DataType::kBreak: {
+        // An indefinite-length container's child count is known at its break
+        uint64_t children = (stack.depth() > 0) ? stack.count() : 0;
+        if (!stack.endBreak()) {
+          return fail(WellFormedError::kSyntaxError);
+        }
+        Node &node = nodes_[open[stack.depth()]];
+        node.length = static_cast<uint32_t>(children);
+        node.next = static_cast<uint32_t>(size_);
+        break;
+      }
+
+      case DataType::kEOS:
+        return fail(WellFormedError::kEOS);
+      case DataType::kSyntaxError:
+      default:
+        return fail(WellFormedError::kSyntaxError);
+    }
+
+    // A child is complete, so count it against the enclosing nodes, ending
+    // any that are now complete
+    int ended = stack.endItem();
+    for (int i = 0; i < ended; i++) {
+      nodes_[open[stack.depth() + i]].next = static_cast<uint32_t>(size_);
+    }
+    if (stack.depth() == 0) {
+      parsedSize_ = r.getIndex();
+      return true;
+    }
+  }
+}
+
+bool Document::addNode(DataType type, uint64_t value, uint32_t length,
+                       bool isIndefinite) {
+  if (size_ >= capacity_) {
+    full_ = true;
+    return false;
+  }
+  Node &node = nodes_[size_++];
+  node.value = value;
+  node.length = length;
+  node.next = static_cast<uint32_t>(size_);
+  node.type = type;
+  node.isIndefinite = isIndefinite;
+  return true;
+}
+
+bool Document::fitsNode(uint64_t length) {
+  if (length > UINT32_MAX) {
+    full_ = true;
+    return false;
+  }
+  return true;
+}
+
+bool Document::fail(WellFormedError err) {
+  error_ = err;
+  return false;
+}
+
+uint64_t Document::getLength(uint32_t n) const {
+  if (n >= size_) {
+    return 0;
+  }
+  const Node &node = nodes_[n];
+  switch (node.type) {
+    case DataType::kBytes:
+    case DataType::kText:
+      return node.isIndefinite ? 0 : node.length;
+    case DataType::kArray:
+      return node.length;
+    case DataType::kMap:
+      return node.length / 2;
+    default:
+      return 0;
+  }
+}
+
+uint32_t Document::getChildCount(uint32_t n) const {
+  if (n >= size_) {
+    return 0;
+  }
+  const Node &node = nodes_[n];
+  switch (node.type) {
+    case DataType::kBytes:
+    case DataType::kText:
+      return node.isIndefinite ? node.length : 0;
+    case DataType::kArray:
+    case DataType::kMap:
+    case DataType::kTag:
+      return node.length;
+    default:
+      return 0;
+  }
+}
+
+uint32_t Document::getChild(uint32_t n, uint32_t index) const {
+  if (index >= getChildCount(n)) {
+    return kNoNode;
+  }
+  uint32_t child = n + 1;
+  while (index-- > 0) {
+    child = nodes_[child].next;
+  }
+  return child;
+}
+
+uint32_t Document::find(uint32_t map, const char *key) const {
+  return find(map, reinterpret_cast<const uint8_t *>(key), strlen(key));
+}
+
+uint32_t Document::find(uint32_t map, const uint8_t *key, size_t len) const {
+  if (getType(map) != DataType::kMap) {
+    return kNoNode;
+  }
+  uint32_t k = map + 1;
+  for (uint32_t i = nodes_[map].length / 2; i > 0; i--) {
+    const Node &node = nodes_[k];
+    if (node.type == DataType::kText && !node.isIndefinite &&
+        node.length == len &&
+        memcmp(&data_[node.value], key, len) == 0) {
+      return node.next;
+    }
+    k = nodes_[node.next].next;
+  }
+  return kNoNode;
+}
+
+uint32_t Document::findInt(uint32_t map, int64_t key) const {
+  if (getType(map) != DataType::kMap) {
+    return kNoNode;
+  }
+  DataType type;
+  uint64_t value;
+  if (key < 0) {
+    type = DataType::kNegativeInt;
+    value = ~static_cast<uint64_t>(key);
+  } else {
+    type = DataType::kUnsignedInt;
+    value = static_cast<uint64_t>(key);
+  }
+  uint32_t k = map + 1;
+  for (uint32_t i = nodes_[map].length / 2; i > 0; i--) {
+    const Node &node = nodes_[k];
+    if (node.type == type && node.value == value) {
+      return node.next;
+    }
+    k = nodes_[node.next].next;
+  }
+  return kNoNode;
+}
+
+const uint8_t *Document::getBytes(uint32_t n) const {
+  DataType type = getType(n);
+  if ((type != DataType::kBytes && type != DataType::kText) ||
+      nodes_[n].isIndefinite) {
+    return nullptr;
+  }
+  return &data_[nodes_[n].value];
+}
+
+uint64_t Document::getUnsignedInt(uint32_t n) const {
+  if (getType(n) != DataType::kUnsignedInt) {
+    return 0;
+  }
+  return nodes_[n].value;
+}
+
+int64_t Document::getInt(uint32_t n) const {
+  switch (getType(n)) {
+    case DataType::kUnsignedInt:
+      return static_cast<int64_t>(nodes_[n].value);
+    case DataType::kNegativeInt:
+      return static_cast<int64_t>(~nodes_[n].value);
+    default:
+      return 0;
+  }
+}
+
+bool Document::getBoolean(uint32_t n) const {
+  return getType(n) == DataType::kBoolean && nodes_[n].value != 0;
+}
+
+float Document::getFloat(uint32_t n) const {
+  return static_cast<float>(getDouble(n));
+}
+
+double Document::getDouble(uint32_t n) const {
+  DataType type = getType(n);
+  if (type != DataType::kFloat && type != DataType::kDouble) {
+    return 0.0;
+  }
+  double d;
+  memcpy(&d, &nodes_[n].value, sizeof(d));
+  return d;
+}
+
+uint8_t Document::getSimpleValue(uint32_t n) const {
+  if (getType(n) != DataType::kSimpleValue) {
+    return 0;
+  }
+  return static_cast<uint8_t>(nodes_[n].value);
+}
+
+uint64_t Document::getTag(uint32_t n) const {
+  if (getType(n) != DataType::kTag) {
+    return 0;
+  }
+  return nodes_[n].value;
+}
+
+// ***************************************************************************
+//  MapIndex
+// ***************************************************************************
+
+// Compares two keys in the deterministic order, returning a negative value,
+// zero, or a positive value. The order is the same as comparing the shortest
+// encodings bytewise.
+static int compareKeys(uint8_t mt1, uint64_t v1, const uint8_t *b1,
+                       uint8_t mt2, uint64_t v2, const uint8_t *b2) {
+  if (mt1 != mt2) {
+    return (mt1 < mt2) ? -1 : 1;
+  }
+  if (v1 != v2) {
+    return (v1 < v2) ? -1 : 1;
+  }
+  if (b1 == nullptr || v1 == 0) {
+    return 0;
+  }
+  return memcmp(b1, b2, static_cast<size_t>(v1));
+}
+
+bool MapIndex::build(const Document &doc, uint32_t map, bool trustOrder) {
+  size_ = 0;
+  doc_ = &doc;
+  sorted_ = false;
+  if (doc.getType(map) != DataType::kMap) {
+    return false;
+  }
+  size_t n = doc.nodes_[map].length / 2;
+  if (n > capacity_) {
+    return false;
+  }
+
+  bool sorted = true;
+  Key prev{0, 0, nullptr};
+  uint32_t k = map + 1;
+  for (size_t i = 0; i < n; i++) {
+    keys_[i] = k;
+    if (!trustOrder && sorted) {
+      Key key{0, 0, nullptr};
+      if (!getKey(k, &key) ||
+          (i > 0 && compareKeys(prev.majorType, prev.value, prev.bytes,
+                                key.majorType, key.value, key.bytes) >= 0)) {
+        sorted = false;
+      }
+      prev = key;
+    }
+    k = doc.nodes_[doc.nodes_[k].next].next;
+  }
+  size_ = n;
+  sorted_ = sorted;
+  return true;
+}
+
+bool MapIndex::getKey(uint32_t n, Key *key) const {
+  const Document::Node &node = doc_->nodes_[n];
+  switch (node.type) {
+    case DataType::kUnsignedInt:
+      *key = Key{0, node.value, nullptr};
+      return true;
+    case DataType::kNegativeInt:
+      *key = Key{1, node.value, nullptr};
+      return true;
+    case DataType::kBytes:
+    case DataType::kText:
+      if (node.isIndefinite) {
+        return false;
+      }
+      *key = Key{static_cast<uint8_t>((node.type == DataType::kBytes) ? 2 : 3),
+                 node.length, &doc_->data_[node.value]};
+      return true;
+    default:
+      return false;
+  }
+}
+
+uint32_t MapIndex::findKey(int64_t key) const {
+  if (key < 0) {
+    return findKey(Key{1, ~static_cast<uint64_t>(key), nullptr});
+  }
+  return findKey(Key{0, static_cast<uint64_t>(key), nullptr});
+}
+
+uint32_t MapIndex::findKey(const char *key) const {
+  return findKey(reinterpret_cast<const uint8_t *>(key), strlen(key));
+}
+
+uint32_t MapIndex::findKey(const uint8_t *key, size_t len) const {
+  return findKey(Key{3, len, key});
+}
+
+uint32_t MapIndex::findKey(const Key &key) const {
+  if (sorted_) {
+    size_t lo = 0;
+    size_t hi = size_;
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo)/2;
+      Key k;
+      if (!getKey(keys_[mid], &k)) {
+        // Other key types sort after these
+        k = Key{0xff, 0, nullptr};
+      }
+      int c = compareKeys(k.majorType, k.value, k.bytes,
+                          key.majorType, key.value, key.bytes);
+      if (c == 0) {
+        return doc_->nodes_[keys_[mid]].next;
+      }
+      if (c < 0) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return Document::kNoNode;
+  }
+
+  for (size_t i = 0; i < size_; i++) {
+    Key k;
+    if (getKey(keys_[i], &k) &&
+        compareKeys(k.majorType, k.value, k.bytes,
+                    key.majorType, key.value, key.bytes) == 0) {
+      return doc_->nodes_[keys_[i]].next;
+    }
+  }
+  return Document::kNoNode;
+}
+
+}  // namespace cbor
+}  // namespace qindesign
@@ -0,0 +1,281 @@
+// CBOR_document.h defines an in-memory tree of decoded data items.
+// This is part of libCBOR.
+// (c) 2017 Shawn Silverman
+
+#ifndef CBOR_DOCUMENT_H_
+#define CBOR_DOCUMENT_H_
+
+// C++ includes
+#ifdef __has_include
+#if __has_include(<cstddef>)
+#include <cstddef>
+#else
+#include <stddef.h>
+#endif
+#if __has_include(<cstdint>)
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+#else
+#include <cstddef>
+#include <cstdint>
+#endif
+
+// Project includes
+#include "CBOR.h"
+
+namespace qindesign {
+namespace cbor {
+
+// Document decodes a data item once into a tree of nodes so that it can be
+// queried randomly; for example, for several lookups by map key. The nodes
+// are stored in a flat array provided by the caller, in depth-first order, so
+// no memory is allocated. Bytes and text are not copied: they refer to the
+// source buffer, which must remain valid for as long as the nodes are used.
+//
+// Nodes are referred to by their index. The root is always node zero. The
+// children of an array, map, or tag start at the index following their
+// parent, and each node records where its subtree ends, so siblings can be
+// traversed without visiting their children. Map children alternate between
+// keys and values.
+//
+// For example:
+//   Document::Node nodes[64];
+//   Document doc{nodes, 64};
+//   if (doc.parse(buf, len)) {
+//     uint32_t n = doc.find(0, "temp");
+//     if (n != Document::kNoNode) {
+//       double temp = doc.getDouble(n);
+//     }
+//   }
+class Document {
+ public:
+  // Indicates that there's no such node.
+  static constexpr uint32_t kNoNode = ~uint32_t{0};
+
+  // A single decoded data item. The contents are used internally.
+  struct Node {
+    // Integer value, tag, simple value, floating-point value, or the offset
+    // of bytes or text in the source
+    uint64_t value;
+    uint32_t length;  // Bytes or text length, or the number of children
+    uint32_t next;    // The index just past this node's subtree
+    DataType type;
+    bool isIndefinite;
+  };
+
+  // Creates a new document that stores up to capacity nodes in the given
+  // array. The array must remain valid for the lifetime of this object.
+  Document(Node *nodes, size_t capacity)
+      : nodes_(nodes),
+        capacity_((nodes == nullptr) ? 0 : capacity),
+        size_(0),
+        data_(nullptr),
+        parsedSize_(0),
+        error_(WellFormedError::kNoError),
+        full_(false) {}
+
+  ~Document() = default;
+
+  // Decodes the first data item in the given buffer, replacing any previous
+  // contents. Arrays, maps, and tags may be nested up to maxDepth levels,
+  // which is limited to kMaxDepth. Note that, unlike Reader::isWellFormed(),
+  // tags count as a level here because they have a child node.
+  //
+  // This returns false if the item is not well-formed or if it needs more
+  // nodes than the capacity. getError() and isFull() indicate which.
+  bool parse(const uint8_t *data, size_t size, int maxDepth = kMaxDepth);
+
+  // Returns why the last parse failed, or WellFormedError::kNoError if it
+  // didn't fail because of the data.
+  WellFormedError getError() const {
+    return error_;
+  }
+
+  // Returns whether the last parse failed because it ran out of nodes, or
+  // because a length was too large to store in a node.
+  bool isFull() const {
+    return full_;
+  }
+
+  // Returns the number of nodes in use.
+  size_t size() const {
+    return size_;
+  }
+
+  // Returns the number of bytes of the source that were decoded.
+  size_t getParsedSize() const {
+    return parsedSize_;
+  }
+
+  // Returns the type of the given node. The type of an invalid node is
+  // DataType::kEOS.
+  DataType getType(uint32_t n) const {
+    return (n < size_) ? nodes_[n].type : DataType::kEOS;
+  }
+
+  // Returns whether the given bytes, text, array, or map has an
+  // indefinite length.
+  bool isIndefiniteLength(uint32_t n) const {
+    return (n < size_) && nodes_[n].isIndefinite;
+  }
+
+  // Returns the length of the given definite-length bytes or text, the
+  // number of items in an array, or the number of pairs in a map. This
+  // returns zero for other nodes and for indefinite-length bytes and text,
+  // whose children are the chunks.
+  uint64_t getLength(uint32_t n) const;
+
+  // Returns the number of child nodes. For maps, this is twice the number of
+  // pairs, for tags, this is one, and for indefinite-length bytes and text,
+  // this is the number of non-empty chunks.
+  uint32_t getChildCount(uint32_t n) const;
+
+  // Returns the first child of the given node, or kNoNode if there are
+  // no children.
+  uint32_t getFirstChild(uint32_t n) const {
+    return (getChildCount(n) > 0) ? n + 1 : kNoNode;
+  }
+
+  // Returns the child at the given index, or kNoNode if there's no such
+  // child. This takes time proportional to the index, but not to the size
+  // of the children's subtrees.
+  uint32_t getChild(uint32_t n, uint32_t index) const;
+
+  // Returns the index just past the subtree of the given node. For all but
+  // the last child of a parent, this is the next sibling.
+  uint32_t getNext(uint32_t n) const {
+    return (n < size_) ? nodes_[n].next : kNoNode;
+  }
+
+  // Finds the value for the given text key in a map node. This returns
+  // kNoNode if the node isn't a map or if the key wasn't found. Only
+  // definite-length text keys are matched.
+  uint32_t find(uint32_t map, const char *key) const;
+  uint32_t find(uint32_t map, const uint8_t *key, size_t len) const;
+
+  // Finds the value for the given integer key in a map node. This returns
+  // kNoNode if the node isn't a map or if the key wasn't found.
+  uint32_t findInt(uint32_t map, int64_t key) const;
+
+  // Returns the contents of the given definite-length bytes or text. The
+  // data points into the source buffer. This returns nullptr for other
+  // nodes.
+  const uint8_t *getBytes(uint32_t n) const;
+
+  // Value getters. These follow the same contract as the Reader getters,
+  // returning zero or false if the node is not of the correct type.
+  uint64_t getUnsignedInt(uint32_t n) const;
+  int64_t getInt(uint32_t n) const;
+  bool getBoolean(uint32_t n) const;
+  float getFloat(uint32_t n) const;
+  double getDouble(uint32_t n) const;
+  uint8_t getSimpleValue(uint32_t n) const;
+  uint64_t getTag(uint32_t n) const;
+
+ private:
+  friend class MapIndex;
+
+  // Adds a node, and returns false if there's no more room.
+  bool addNode(DataType type, uint64_t value, uint32_t length,
+               bool isIndefinite);
+
+  // Checks that a length fits in a node, and marks the document as full if
+  // it doesn't.
+  bool fitsNode(uint64_t length);
+
+  // Sets the error and returns false.
+  bool fail(WellFormedError err);
+
+  Node *nodes_;
+  size_t capacity_;
+  size_t size_;
+
+  const uint8_t *data_;
+  size_t parsedSize_;
+  WellFormedError error_;
+  bool full_;
+};
+
+// MapIndex records the keys of a map in a Document so that they can be
+// looked up in O(log n) time when they're in the deterministic order from
+// RFC 8949. That order sorts keys by their encoded bytes: unsigned integers
+// in increasing order, then negative integers in decreasing order, then
+// bytes, then text, with strings sorted by length and then by contents. Maps
+// whose keys are in a different order, or are of some other type, are still
+// searched, but linearly, which is still faster than Document::find() because
+// the values aren't visited.
+//
+// For example:
+//   uint32_t keys[2000];
+//   MapIndex index{keys, 2000};
+//   if (index.build(doc, map)) {
+//     uint32_t value = index.findKey(1234);
+//   }
+class MapIndex {
+ public:
+  // Creates a new index that stores up to capacity key node indexes in the
+  // given array. The array must remain valid for the lifetime of this object.
+  MapIndex(uint32_t *keys, size_t capacity)
+      : keys_(keys),
+        capacity_((keys == nullptr) ? 0 : capacity),
+        size_(0),
+        doc_(nullptr),
+        sorted_(false) {}
+
+  ~MapIndex() = default;
+
+  // Records the keys of the given map node and checks whether they're in
+  // deterministic order. If trustOrder is true then the check is skipped, and
+  // the keys are assumed to be in order; lookups will be wrong if they're
+  // not. The document must remain unchanged for as long as this index
+  // is used.
+  //
+  // This returns false if the node isn't a map or if it has more pairs than
+  // the capacity.
+  bool build(const Document &doc, uint32_t map, bool trustOrder = false);
+
+  // Returns whether the keys are sorted and lookups use a binary search.
+  bool isSorted() const {
+    return sorted_;
+  }
+
+  // Returns the number of recorded keys.
+  size_t size() const {
+    return size_;
+  }
+
+  // Finds the value for the given key, returning Document::kNoNode if the
+  // key wasn't found.
+  uint32_t findKey(int64_t key) const;
+  uint32_t findKey(const char *key) const;
+  uint32_t findKey(const uint8_t *key, size_t len) const;
+
+ private:
+  // A key in comparable form.
+  struct Key {
+    uint8_t majorType;
+    uint64_t value;  // The integer value or the string length
+    const uint8_t *bytes;
+  };
+
+  // Gets the comparable form of the given key node. This returns false if
+  // the key can't be compared.
+  bool getKey(uint32_t n, Key *key) const;
+
+  // Finds the value for the given key.
+  uint32_t findKey(const Key &key) const;
+
+  uint32_t *keys_;
+  size_t capacity_;
+  size_t size_;
+
+  const Document *doc_;
+  bool sorted_;
+};
+
+}  // namespace cbor
+}  // namespace qindesign
+
+#endif  // CBOR_DOCUMENT_H_
@@ -0,0 +1,54 @@
+// CBOR_index.cpp is part of libCBOR.
+// (c) 2017 Shawn Silverman
+
+#include "CBOR_index.h"
+
+namespace qindesign {
+namespace cbor {
+
+// The initial byte for a break.
+constexpr int kBreak = (7 << 5) + 31;
+
+bool ItemIndex::build(Reader &r, uint32_t base) {
+  size_ = 0;
+  length_ = 0;
+  endOffset_ = base;
+
+  size_t start = r.getReadSize();
+  switch (r.readDataType()) {
+    case DataType::kArray:
+      isMap_ = false;
+      break;
+    case DataType::kMap:
+      isMap_ = true;
+      break;
+    default:
+      return false;
+  }
+  bool indefinite = r.isIndefiniteLength();
+  uint64_t length = r.getLength();
+
+  while (indefinite || length_ < length) {
+    uint32_t offset = base + static_cast<uint32_t>(r.getReadSize() - start);
+    if (indefinite && r.peek() == kBreak) {
+      r.read();
+      break;
+    }
+    if (size_ < capacity_) {
+      offsets_[size_++] = offset;
+    }
+    if (!r.skipItem()) {
+      return false;
+    }
+    if (isMap_ && !r.skipItem()) {
+      return false;
+    }
+    length_++;
+  }
+
+  endOffset_ = base + static_cast<uint32_t>(r.getReadSize() - start);
+  return true;
+}
+
+}  // namespace cbor
+}  // namespace qindesign
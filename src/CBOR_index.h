@@ -0,0 +1,115 @@
+// CBOR_index.h defines an index for random access to the items in an array
+// or map.
+// This is part of libCBOR.
+// (c) 2017 Shawn Silverman
+
+#ifndef CBOR_INDEX_H_
+#define CBOR_INDEX_H_
+
+// C++ includes
+#ifdef __has_include
+#if __has_include(<cstddef>)
+#include <cstddef>
+#else
+#include <stddef.h>
+#endif
+#if __has_include(<cstdint>)
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+#else
+#include <cstddef>
+#include <cstdint>
+#endif
+
+// Project includes
+#include "CBOR.h"
+
+namespace qindesign {
+namespace cbor {
+
+// ItemIndex records the positions of the items in an array, or of the
+// key/value pairs in a map, in a single pass. The positions are stored in
+// a caller-provided array; no memory is allocated. Afterwards, the source
+// can be positioned directly at any item; for example, with
+// BytesStream::seek(), EEPROMStream::seek(), or BufferReader::seek().
+//
+// For example:
+//   uint32_t offsets[100];
+//   ItemIndex index{offsets, 100};
+//   if (index.build(r, es.getAddress())) {
+//     es.seek(index.getOffset(42));
+//     // Read the item
+//   }
+class ItemIndex {
+ public:
+  // Creates a new index that stores up to capacity offsets in the given
+  // array. The array must remain valid for the lifetime of this object.
+  ItemIndex(uint32_t *offsets, size_t capacity)
+      : offsets_(offsets),
+        capacity_((offsets == nullptr) ? 0 : capacity),
+        size_(0),
+        length_(0),
+        endOffset_(0),
+        isMap_(false) {}
+
+  ~ItemIndex() = default;
+
+  // Reads the next data item, which must be an array or a map, and records
+  // the offset of each array element, or of each map key, up to the
+  // capacity. Any remaining items are still traversed so that the reader
+  // ends up just past the container. Definite- and indefinite-length
+  // containers are both supported.
+  //
+  // Offsets are the number of bytes from the current reader position plus
+  // the given base. Passing the current position of the underlying source
+  // as the base makes the offsets directly usable for seeking.
+  //
+  // This returns false if the next item is not an array or map, or if the
+  // container is not well-formed. The items are checked using the same
+  // traversal as Reader::isWellFormed().
+  bool build(Reader &r, uint32_t base = 0);
+
+  // Returns whether the last indexed container was a map.
+  bool isMap() const {
+    return isMap_;
+  }
+
+  // Returns the number of items in the container, or the number of pairs
+  // for a map. This may be larger than the number of stored offsets.
+  uint64_t getLength() const {
+    return length_;
+  }
+
+  // Returns the number of offsets that were stored.
+  size_t size() const {
+    return size_;
+  }
+
+  // Returns the offset of the item at the given index, or of the key for
+  // the pair at the given index if the container is a map. This returns
+  // the end offset if the index is out of range.
+  uint32_t getOffset(size_t index) const {
+    return (index < size_) ? offsets_[index] : endOffset_;
+  }
+
+  // Returns the offset just past the end of the container.
+  uint32_t getEndOffset() const {
+    return endOffset_;
+  }
+
+ private:
+  uint32_t *offsets_;
+  size_t capacity_;
+
+  size_t size_;
+  uint64_t length_;
+  uint32_t endOffset_;
+  bool isMap_;
+};
+
+}  // namespace cbor
+}  // namespace qindesign
+
+#endif  // CBOR_INDEX_H_
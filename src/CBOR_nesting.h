@@ -0,0 +1,159 @@
+// CBOR_nesting.h defines the bookkeeping that the parsers share for tracking
+// nested arrays, maps, and tags. It's only for use within the library.
+// This is part of libCBOR.
+// (c) 2017 Shawn Silverman
+
+#ifndef CBOR_NESTING_H_
+#define CBOR_NESTING_H_
+
+// C++ includes
+#ifdef __has_include
+#if __has_include(<cstdint>)
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+#else
+#include <cstdint>
+#endif
+
+// Project includes
+#include "CBOR.h"
+
+namespace qindesign {
+namespace cbor {
+namespace detail {
+
+// Major types
+constexpr int kUnsignedInt   = 0;
+constexpr int kNegativeInt   = 1;
+constexpr int kBytes         = 2;
+constexpr int kText          = 3;
+constexpr int kArray         = 4;
+constexpr int kMap           = 5;
+constexpr int kTag           = 6;
+constexpr int kSimpleOrFloat = 7;
+
+// Container kinds
+constexpr uint8_t kDefinite        = 0;
+constexpr uint8_t kIndefiniteArray = 1;
+constexpr uint8_t kIndefiniteMap   = 2;
+
+// Converts the number of pairs in a definite-length map to its number of
+// items. This returns false if the count doesn't fit.
+inline bool mapItemCount(uint64_t pairs, uint64_t *count) {
+  if (pairs != 0 && 2*pairs <= pairs) {
+    return false;
+  }
+  *count = pairs << 1;
+  return true;
+}
+
+// NestingStack tracks the containers that are open while parsing, and
+// whether a tag is waiting for its item. It enforces the nesting limit and
+// the rules for where a break may appear.
+//
+// Parsers call begin() for each non-empty container, endBreak() for each
+// break, and endItem() after every complete item, including containers that
+// were just ended by a break.
+class NestingStack {
+ public:
+  NestingStack() : depth_(0), tagged_(false) {}
+  ~NestingStack() = default;
+
+  // Empties the stack.
+  void reset() {
+    depth_ = 0;
+    tagged_ = false;
+  }
+
+  // Returns the number of open containers.
+  int depth() const {
+    return depth_;
+  }
+
+  // Returns whether a tag is waiting for its item.
+  bool isTagged() const {
+    return tagged_;
+  }
+
+  // Sets whether a tag is waiting for its item.
+  void setTagged(bool flag) {
+    tagged_ = flag;
+  }
+
+  // Returns whether the innermost container has an indefinite length. The
+  // stack must not be empty.
+  bool isIndefinite() const {
+    return kinds_[depth_ - 1] != kDefinite;
+  }
+
+  // Returns the count for the innermost container: the number of items still
+  // outstanding for a definite length, or the number of items seen so far
+  // for an indefinite length. The stack must not be empty.
+  uint64_t count() const {
+    return counts_[depth_ - 1];
+  }
+
+  // Opens a container, given its number of items for a definite length,
+  // which must not be zero. This returns false if the container would be
+  // nested deeper than maxDepth.
+  bool begin(uint64_t count, bool indefinite, bool isMap, int maxDepth) {
+    if (depth_ >= maxDepth) {
+      return false;
+    }
+    counts_[depth_] = indefinite ? 0 : count;
+    kinds_[depth_] = !indefinite ? kDefinite
+                     : isMap     ? kIndefiniteMap
+                                 : kIndefiniteArray;
+    depth_++;
+    tagged_ = false;
+    return true;
+  }
+
+  // Ends the innermost container at a break. A break must end an
+  // indefinite-length container, not follow a tag, and for maps, only come
+  // after a complete pair. This returns false, without changing anything,
+  // if the break isn't allowed.
+  bool endBreak() {
+    if (tagged_ || depth_ == 0 || kinds_[depth_ - 1] == kDefinite ||
+        (kinds_[depth_ - 1] == kIndefiniteMap &&
+         (counts_[depth_ - 1] & 1) != 0)) {
+      return false;
+    }
+    depth_--;
+    return true;
+  }
+
+  // Counts a complete item against the enclosing containers, ending any
+  // definite-length containers that are now complete. This returns the
+  // number of containers that were ended.
+  int endItem() {
+    int ended = 0;
+    tagged_ = false;
+    while (depth_ > 0) {
+      if (kinds_[depth_ - 1] != kDefinite) {
+        counts_[depth_ - 1]++;
+        break;
+      }
+      if (--counts_[depth_ - 1] != 0) {
+        break;
+      }
+      depth_--;
+      ended++;
+    }
+    return ended;
+  }
+
+ private:
+  uint64_t counts_[kMaxDepth];
+  uint8_t kinds_[kMaxDepth];
+  int depth_;
+  bool tagged_;
+};
+
+}  // namespace detail
+}  // namespace cbor
+}  // namespace qindesign
+
+#endif  // CBOR_NESTING_H_
@@ -0,0 +1,141 @@
+// CBOR_packed.cpp is part of libCBOR.
+// (c) 2017 Shawn Silverman
+
+#include "CBOR_packed.h"
+
+// C++ includes
+#ifdef __has_include
+#if __has_include(<cstring>)
+#include <cstring>
+#else
+#include <string.h>
+#endif
+#else
+#include <cstring>
+#endif
+
+// Project includes
+#include "CBOR_parsing.h"
+
+namespace qindesign {
+namespace cbor {
+
+// The number of shared items referred to by simple values.
+constexpr size_t kSimpleRefs = 16;
+
+int KeyDictionary::find(const char *key) const {
+  if (key == nullptr) {
+    return -1;
+  }
+  return find(reinterpret_cast<const uint8_t *>(key), strlen(key));
+}
+
+int KeyDictionary::find(const uint8_t *key, size_t len) const {
+  for (size_t i = 0; i < count_; i++) {
+    const char *k = keys_[i];
+    if (k != nullptr && strlen(k) == len && memcmp(k, key, len) == 0) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+void writeSharedRef(Writer &w, size_t index) {
+  if (index < kSimpleRefs) {
+    w.writeSimpleValue(index);
+    return;
+  }
+  index -= kSimpleRefs;
+  w.writeTag(kSharedRefTag);
+  if ((index & 1) == 0) {
+    w.writeUnsignedInt(index >> 1);
+  } else {
+    w.writeInt(-1 - static_cast<int64_t>(index >> 1));
+  }
+}
+
+// Writes a text string. A null string is written as empty text.
+static void writeText(Writer &w, const char *s) {
+  if (s == nullptr) {
+    s = "";
+  }
+  size_t len = strlen(s);
+  w.beginText(len);
+  w.writeBytes(reinterpret_cast<const uint8_t *>(s), len);
+}
+
+void writeKey(Writer &w, const KeyDictionary &dict, const char *key) {
+  int index = dict.find(key);
+  if (index >= 0) {
+    writeSharedRef(w, index);
+  } else {
+    writeText(w, key);
+  }
+}
+
+void beginPacked(Writer &w, const KeyDictionary &dict) {
+  w.writeTag(kPackedTag);
+  w.beginArray(2);
+  w.beginArray(dict.size());
+  for (size_t i = 0; i < dict.size(); i++) {
+    writeText(w, dict.get(i));
+  }
+}
+
+bool expectSharedRef(Reader &r, size_t *index) {
+  switch (r.readDataType()) {
+    case DataType::kSimpleValue:
+      if (r.getSimpleValue() >= kSimpleRefs) {
+        return false;
+      }
+      *index = r.getSimpleValue();
+      return true;
+
+    case DataType::kTag: {
+      if (r.getTag() != kSharedRefTag) {
+        return false;
+      }
+      DataType dt = r.readDataType();
+      uint64_t n;
+      if (dt == DataType::kUnsignedInt) {
+        n = r.getUnsignedInt();
+      } else if (dt == DataType::kNegativeInt) {
+        n = ~static_cast<uint64_t>(r.getInt());
+      } else {
+        return false;
+      }
+
+      // Check that the index fits
+      if (n > (~size_t{0} - kSimpleRefs - 1) / 2) {
+        return false;
+      }
+      *index = kSimpleRefs + 2*static_cast<size_t>(n) +
+               ((dt == DataType::kNegativeInt) ? 1 : 0);
+      return true;
+    }
+
+    default:
+      return false;
+  }
+}
+
+bool expectPacked(Reader &r, const KeyDictionary &dict) {
+  if (!expectTagValue(r, kPackedTag) || !expectArrayLength(r, 2) ||
+      !expectArrayLength(r, dict.size())) {
+    return false;
+  }
+  for (size_t i = 0; i < dict.size(); i++) {
+    const char *key = dict.get(i);
+    if (key == nullptr) {
+      key = "";
+    }
+    if (!expectDefiniteText(r, reinterpret_cast<const uint8_t *>(key),
+                            strlen(key))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace cbor
+}  // namespace qindesign
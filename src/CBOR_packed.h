@@ -0,0 +1,125 @@
+// CBOR_packed.h defines support for replacing repeated map keys with
+// references into a shared dictionary, as in packed CBOR.
+// This is part of libCBOR.
+// (c) 2017 Shawn Silverman
+
+#ifndef CBOR_PACKED_H_
+#define CBOR_PACKED_H_
+
+// C++ includes
+#ifdef __has_include
+#if __has_include(<cstddef>)
+#include <cstddef>
+#else
+#include <stddef.h>
+#endif
+#if __has_include(<cstdint>)
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+#else
+#include <cstddef>
+#include <cstdint>
+#endif
+
+// Project includes
+#include "CBOR.h"
+
+namespace qindesign {
+namespace cbor {
+
+// Tag for packed CBOR: a two-element array holding the table of shared
+// items and then the data item that refers to them.
+constexpr uint8_t kPackedTag = 113;
+
+// Tag for a reference to a shared item past the first 16.
+constexpr uint8_t kSharedRefTag = 6;
+
+// KeyDictionary is a table of text keys that both the writer and the reader
+// know, such as the keys that every telemetry message repeats. Each key can
+// then be sent as a shared item reference, which takes one byte for the
+// first 16 keys and two or three bytes for the rest, and the reader can
+// match keys by comparing indexes instead of text.
+//
+// References follow the packed CBOR draft: simple values 0-15 refer to
+// items 0-15, tag 6 wrapping an unsigned integer n refers to item 16 + 2n,
+// and tag 6 wrapping a negative integer -1 - n refers to item 16 + 2n + 1.
+// The table can either be agreed on out of band, or sent in front of the
+// data with beginPacked() so that the message is self-contained.
+//
+// For example:
+//   static const char *const kKeys[]{"timestamp", "temperature"};
+//   KeyDictionary dict{kKeys, 2};
+//
+//   w.beginMap(1);
+//   writeKey(w, dict, "temperature");  // Written as simple(1)
+//   w.writeFloat(t);
+//
+//   size_t key;
+//   if (expectSharedRef(r, &key) && key == 1) {
+//     // Read the temperature
+//   }
+class KeyDictionary {
+ public:
+  // Creates a new dictionary from the given array of NUL-terminated keys,
+  // where each key's index is its position. The array and the keys must
+  // remain valid for the lifetime of this object.
+  KeyDictionary(const char *const *keys, size_t count)
+      : keys_(keys),
+        count_((keys == nullptr) ? 0 : count) {}
+
+  ~KeyDictionary() = default;
+
+  // Returns the number of keys.
+  size_t size() const {
+    return count_;
+  }
+
+  // Returns the key at the given index, or nullptr if the index is out
+  // of range.
+  const char *get(size_t index) const {
+    return (index < count_) ? keys_[index] : nullptr;
+  }
+
+  // Returns the index of the given key, or -1 if it isn't in the dictionary.
+  // This is a linear search, so writers that know a key's index can use
+  // writeSharedRef() directly instead.
+  int find(const char *key) const;
+  int find(const uint8_t *key, size_t len) const;
+
+ private:
+  const char *const *keys_;
+  const size_t count_;
+};
+
+// Writes a reference to the shared item at the given index.
+void writeSharedRef(Writer &w, size_t index);
+
+// Writes the given key as a shared item reference if it's in the dictionary
+// and as text otherwise. A null key is written as empty text, the same way
+// beginPacked() writes null dictionary entries.
+void writeKey(Writer &w, const KeyDictionary &dict, const char *key);
+
+// Starts a self-contained packed data item by writing the packed tag, the
+// head of its two-element array, and the dictionary as the table of shared
+// items. The data item that uses the references must be written next.
+void beginPacked(Writer &w, const KeyDictionary &dict);
+
+// Expects a shared item reference and fills in its index. If the next item
+// is something else, for example a key that was written as text, then this
+// returns false and, like the expectation functions, leaves that item as
+// the current one so that it can still be examined; for a tag other than
+// the shared item tag, only the tag has been read.
+bool expectSharedRef(Reader &r, size_t *index);
+
+// Expects the start of a packed data item whose table of shared items is the
+// same as the given dictionary, so that the references in the data item that
+// follows can be matched against it. This returns false if the tag or the
+// table is different.
+bool expectPacked(Reader &r, const KeyDictionary &dict);
+
+}  // namespace cbor
+}  // namespace qindesign
+
+#endif  // CBOR_PACKED_H_
@@ -351,12 +351,13 @@ bool expectTag(Reader &r, uint64_t *v) {
 size_t readFully(Reader &r, uint8_t *b, size_t len) {
   size_t count = 0;
   while (len > 0) {
-    int read = r.readBytes(b, len);
-    if (read < 0) {
-      return count;
+    size_t read = r.readBytes(b, len);
+    if (read == 0) {
+      break;
     }
-    count += static_cast<size_t>(read);
-    len -= static_cast<size_t>(read);
+    b += read;
+    count += read;
+    len -= read;
   }
   return count;
 }
@@ -372,5 +373,50 @@ DataType readUntilData(Reader &r) {
   }
 }
 
+// Waits once, using the given function or yield().
+static void waitOnce(WaitFunction wait, void *arg) {
+  if (wait != nullptr) {
+    wait(arg);
+  } else {
+    yield();
+  }
+}
+
+size_t readFully(Reader &r, uint8_t *b, size_t len, unsigned long timeout,
+                 WaitFunction wait, void *arg) {
+  unsigned long start = millis();
+  size_t count = 0;
+  while (len > 0 && r.bytesAvailable() > 0) {
+    int avail = r.available();
+    if (avail > 0) {
+      size_t n = (static_cast<size_t>(avail) < len) ? avail : len;
+      size_t read = r.readBytes(b, n);
+      b += read;
+      count += read;
+      len -= read;
+      if (read > 0) {
+        continue;
+      }
+    }
+    if (millis() - start >= timeout) {
+      break;
+    }
+    waitOnce(wait, arg);
+  }
+  return count;
+}
+
+DataType readUntilData(Reader &r, unsigned long timeout, WaitFunction wait,
+                       void *arg) {
+  unsigned long start = millis();
+  while (true) {
+    DataType dt = r.readDataType();
+    if (dt != DataType::kEOS || millis() - start >= timeout) {
+      return dt;
+    }
+    waitOnce(wait, arg);
+  }
+}
+
 }  // namespace cbor
 }  // namespace qindesign
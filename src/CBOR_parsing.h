@@ -189,13 +189,39 @@ bool expectTag(Reader &r, uint64_t *v);
 
 // Attempts to read exactly len bytes into b. This will return the actual
 // number of bytes read, a smaller number than len only if the stream
-// encountered end-of-stream.
+// encountered end-of-stream or the current data item has no more bytes.
 size_t readFully(Reader &r, uint8_t *b, size_t len);
 
 // Reads from the reader until there's some data available. If end-of-stream
 // is encountered then this yields and keeps looking. Forever.
 DataType readUntilData(Reader &r);
 
+// A function that's called while waiting for more data. It's passed the
+// argument given to the read function. This can, for example, run other
+// tasks or service other readers.
+using WaitFunction = void (*)(void *arg);
+
+// Reads up to len bytes of the current bytes or text data item into b,
+// giving up after timeout milliseconds. Only bytes that the stream already
+// has available are read, so this never blocks inside the stream. While
+// there's nothing available, wait is called with arg, or, if wait is null,
+// yield() is called.
+//
+// This returns the number of bytes read, which is less than len if the time
+// ran out or if the data item has no more bytes. A timeout of zero reads
+// only what's available right now. Partial progress is kept, so this can be
+// called again with the remaining length to continue.
+size_t readFully(Reader &r, uint8_t *b, size_t len, unsigned long timeout,
+                 WaitFunction wait = nullptr, void *arg = nullptr);
+
+// Reads the next data type, retrying on end-of-stream until timeout
+// milliseconds have passed. Between tries, wait is called with arg, or, if
+// wait is null, yield() is called. This returns DataType::kEOS if the time
+// ran out. A partially-received data item is kept, so this can be called
+// again to continue.
+DataType readUntilData(Reader &r, unsigned long timeout,
+                       WaitFunction wait = nullptr, void *arg = nullptr);
+
 }  // namespace cbor
 }  // namespace qindesign
 
@@ -0,0 +1,66 @@
+// CBOR_pool.cpp is part of libCBOR.
+// (c) 2017 Shawn Silverman
+
+#include "CBOR_pool.h"
+
+namespace qindesign {
+namespace cbor {
+
+int StreamPool::add(Stream &stream, PushParser &parser) {
+  if (size_ >= capacity_) {
+    return -1;
+  }
+  entries_[size_] = Entry{&stream, &parser};
+  return size_++;
+}
+
+size_t StreamPool::poll() {
+  if (size_ == 0) {
+    return 0;
+  }
+
+  size_t total = 0;
+  int index = next_;
+  for (int i = 0; i < size_; i++) {
+    total += service(index);
+    if (++index >= size_) {
+      index = 0;
+    }
+  }
+  if (++next_ >= size_) {
+    next_ = 0;
+  }
+  return total;
+}
+
+size_t StreamPool::service(int index) {
+  Entry &e = entries_[index];
+  int avail = e.stream->available();
+  if (avail <= 0 || bufSize_ == 0) {
+    return 0;
+  }
+  size_t n = (static_cast<size_t>(avail) < bufSize_) ? avail : bufSize_;
+  n = e.stream->readBytes(buf_, n);
+  if (n == 0) {
+    return 0;
+  }
+
+  size_t itemCount = e.parser->getItemCount();
+  bool ok = e.parser->feed(buf_, n);
+  if (itemFunc_ != nullptr) {
+    for (size_t i = e.parser->getItemCount() - itemCount; i > 0; i--) {
+      itemFunc_(index, itemArg_);
+    }
+  }
+  if (!ok) {
+    WellFormedError err = e.parser->getError();
+    e.parser->reset();
+    if (errorFunc_ != nullptr) {
+      errorFunc_(index, err, errorArg_);
+    }
+  }
+  return n;
+}
+
+}  // namespace cbor
+}  // namespace qindesign
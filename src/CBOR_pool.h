@@ -0,0 +1,143 @@
+// CBOR_pool.h defines a way to service several input streams at once.
+// This is part of libCBOR.
+// (c) 2017 Shawn Silverman
+
+#ifndef CBOR_POOL_H_
+#define CBOR_POOL_H_
+
+// C++ includes
+#ifdef __has_include
+#if __has_include(<cstddef>)
+#include <cstddef>
+#else
+#include <stddef.h>
+#endif
+#if __has_include(<cstdint>)
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+#else
+#include <cstddef>
+#include <cstdint>
+#endif
+
+// Other includes
+#include <Stream.h>
+
+// Project includes
+#include "CBOR.h"
+#include "CBOR_push.h"
+
+namespace qindesign {
+namespace cbor {
+
+// StreamPool multiplexes several input streams, such as serial ports and
+// network connections, each feeding its own PushParser. Every call to poll()
+// services the streams in turn, reading at most one buffer's worth of the
+// bytes each one has available, so no stream blocks the others and the time
+// spent in one call is bounded. The starting stream rotates between calls
+// so that all the streams are treated fairly.
+//
+// Parsers report data items to their visitors as the bytes arrive. The
+// pool can also call a function each time a stream completes a top-level
+// data item or has an error. After an error, the stream's parser is reset;
+// resynchronizing with the data is up to the caller.
+//
+// For example:
+//   StreamPool::Entry entries[2];
+//   uint8_t buf[64];
+//   StreamPool pool{entries, 2, buf, sizeof(buf)};
+//   pool.add(Serial1, parser1);
+//   pool.add(Serial2, parser2);
+//   while (true) {
+//     pool.poll();
+//   }
+class StreamPool {
+ public:
+  // A stream and the parser that receives its data. The contents are used
+  // internally.
+  struct Entry {
+    Stream *stream;
+    PushParser *parser;
+  };
+
+  // Called when the stream at the given index completes a top-level
+  // data item.
+  using ItemFunction = void (*)(int index, void *arg);
+
+  // Called when the data from the stream at the given index is not
+  // well-formed.
+  using ErrorFunction = void (*)(int index, WellFormedError err, void *arg);
+
+  // Creates a new pool that holds up to capacity streams in the given array
+  // and reads into the given buffer. The buffer size is the most that's read
+  // from one stream per poll. The arrays must remain valid for the lifetime
+  // of this object.
+  StreamPool(Entry *entries, int capacity, uint8_t *buf, size_t bufSize)
+      : entries_(entries),
+        capacity_((entries == nullptr || capacity < 0) ? 0 : capacity),
+        size_(0),
+        buf_(buf),
+        bufSize_((buf == nullptr) ? 0 : bufSize),
+        next_(0),
+        itemFunc_(nullptr),
+        itemArg_(nullptr),
+        errorFunc_(nullptr),
+        errorArg_(nullptr) {}
+
+  ~StreamPool() = default;
+
+  // Adds a stream and the parser for its data, and returns the stream's
+  // index. This returns -1 if the pool is full. The stream and parser must
+  // remain valid for as long as they're in the pool.
+  int add(Stream &stream, PushParser &parser);
+
+  // Returns the number of streams.
+  int size() const {
+    return size_;
+  }
+
+  // Sets the function to call when a stream completes a top-level data item.
+  // The function is called after the parser has received the events for all
+  // the bytes read in that round. A null function disables the calls.
+  void setItemFunction(ItemFunction func, void *arg) {
+    itemFunc_ = func;
+    itemArg_ = arg;
+  }
+
+  // Sets the function to call when a stream's data is not well-formed. A
+  // null function disables the calls.
+  void setErrorFunction(ErrorFunction func, void *arg) {
+    errorFunc_ = func;
+    errorArg_ = arg;
+  }
+
+  // Services each stream once, feeding its available bytes, up to the buffer
+  // size, to its parser. This returns the total number of bytes processed;
+  // zero means that no stream had anything available.
+  size_t poll();
+
+ private:
+  // Services one stream and returns the number of bytes processed.
+  size_t service(int index);
+
+  Entry *entries_;
+  int capacity_;
+  int size_;
+
+  uint8_t *buf_;
+  size_t bufSize_;
+
+  int next_;  // The stream to service first in the next poll
+
+  ItemFunction itemFunc_;
+  void *itemArg_;
+  ErrorFunction errorFunc_;
+  void *errorArg_;
+};
+
+}  // namespace cbor
+}  // namespace qindesign
+
+#endif  // CBOR_POOL_H_
@@ -0,0 +1,297 @@
+// CBOR_push.cpp is part of libCBOR.
+// (c) 2017 Shawn Silverman
+
+#include "CBOR_push.h"
+
+// C++ includes
+#ifdef __has_include
+#if __has_include(<cstring>)
+#include <cstring>
+#else
+#include <string.h>
+#endif
+#else
+#include <cstring>
+#endif
+
+namespace qindesign {
+namespace cbor {
+
+using namespace detail;
+
+// The initial byte for a break.
+constexpr uint8_t kBreak = (kSimpleOrFloat << 5) + 31;
+
+bool PushParser::feed(const uint8_t *data, size_t len) {
+  if (error_ != WellFormedError::kNoError) {
+    return false;
+  }
+
+  while (len > 0) {
+    switch (state_) {
+      case State::kHead: {
+        initialByte_ = *(data++);
+        len--;
+        uint8_t ai = initialByte_ & 0x1f;
+        if (ai < 24) {
+          arg_ = ai;
+          processHead();
+        } else if (ai < 28) {
+          argBytes_ = 1 << (ai - 24);
+          arg_ = 0;
+          state_ = State::kArgument;
+        } else if (ai < 31) {
+          return fail(WellFormedError::kSyntaxError);
+        } else {
+          arg_ = 0;
+          processHead();
+        }
+        break;
+      }
+
+      case State::kArgument:
+        while (len > 0 && argBytes_ > 0) {
+          arg_ = (arg_ << 8) | *(data++);
+          len--;
+          argBytes_--;
+        }
+        if (argBytes_ == 0) {
+          state_ = State::kHead;
+          processHead();
+        }
+        break;
+
+      case State::kPayload: {
+        size_t n = (payloadRemaining_ < len)
+                       ? static_cast<size_t>(payloadRemaining_)
+                       : len;
+        if ((initialByte_ >> 5) == kBytes) {
+          visitor_.onBytes(data, n);
+        } else {
+          visitor_.onText(data, n);
+        }
+        data += n;
+        len -= n;
+        payloadRemaining_ -= n;
+        if (payloadRemaining_ == 0) {
+          endStringChunk();
+        }
+        break;
+      }
+    }
+
+    if (error_ != WellFormedError::kNoError) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void PushParser::reset() {
+  state_ = State::kHead;
+  error_ = WellFormedError::kNoError;
+  initialByte_ = 0;
+  argBytes_ = 0;
+  arg_ = 0;
+  payloadRemaining_ = 0;
+  indefiniteString_ = 0;
+  nesting_.reset();
+  itemCount_ = 0;
+}
+
+void PushParser::processHead() {
+  uint8_t majorType = initialByte_ >> 5;
+  uint8_t ai = initialByte_ & 0x1f;  // Additional information
+
+  // Only definite-length chunks of the same type, or a break, may appear
+  // inside an indefinite-length string
+  if (indefiniteString_ != 0 && initialByte_ != kBreak &&
+      (majorType != indefiniteString_ || ai == 31)) {
+    fail(WellFormedError::kSyntaxError);
+    return;
+  }
+
+  switch (majorType) {
+    case kUnsignedInt:
+    case kNegativeInt:
+      if (ai == 31) {
+        fail(WellFormedError::kSyntaxError);
+        return;
+      }
+      if (majorType == kUnsignedInt) {
+        visitor_.onUInt(arg_);
+      } else {
+        visitor_.onNegInt(arg_);
+      }
+      endItem();
+      break;
+
+    case kBytes:
+    case kText:
+      if (ai == 31) {
+        if (majorType == kBytes) {
+          visitor_.onBeginBytes(0, true);
+        } else {
+          visitor_.onBeginText(0, true);
+        }
+        indefiniteString_ = majorType;
+        nesting_.setTagged(false);
+        break;
+      }
+      if (indefiniteString_ == 0) {
+        if (majorType == kBytes) {
+          visitor_.onBeginBytes(arg_, false);
+        } else {
+          visitor_.onBeginText(arg_, false);
+        }
+      }
+      payloadRemaining_ = arg_;
+      if (payloadRemaining_ == 0) {
+        endStringChunk();
+      } else {
+        state_ = State::kPayload;
+      }
+      break;
+
+    case kArray:
+    case kMap:
+      beginContainer(majorType == kMap, arg_, ai == 31);
+      break;
+
+    case kTag:
+      if (ai == 31) {
+        fail(WellFormedError::kSyntaxError);
+        return;
+      }
+      visitor_.onTag(arg_);
+      nesting_.setTagged(true);
+      break;
+
+    case kSimpleOrFloat:
+      switch (ai) {
+        case 20:
+        case 21:
+          visitor_.onBoolean(ai == 21);
+          break;
+        case 22:
+          visitor_.onNull();
+          break;
+        case 23:
+          visitor_.onUndefined();
+          break;
+        case 25:
+          visitor_.onFloat(halfToFloat(static_cast<uint16_t>(arg_)));
+          break;
+        case 26: {
+          float f;
+          uint32_t bits = static_cast<uint32_t>(arg_);
+          memcpy(&f, &bits, 4);
+          visitor_.onFloat(f);
+          break;
+        }
+        case 27: {
+          visitor_.onDouble(doubleFromBits(arg_));
+          break;
+        }
+        case 31:
+          processBreak();
+          return;
+        default:
+          // Values < 20, and 1-byte values
+          visitor_.onSimpleValue(static_cast<uint8_t>(arg_));
+          break;
+      }
+      endItem();
+      break;
+  }
+}
+
+void PushParser::beginContainer(bool isMap, uint64_t length, bool indefinite) {
+  uint64_t count = 0;
+  if (!indefinite) {
+    count = length;
+    if (isMap && !mapItemCount(length, &count)) {
+      fail(WellFormedError::kSyntaxError);
+      return;
+    }
+    if (count == 0) {
+      if (isMap) {
+        visitor_.onBeginMap(0, false);
+      } else {
+        visitor_.onBeginArray(0, false);
+      }
+      visitor_.onEnd();
+      endItem();
+      return;
+    }
+  }
+
+  if (!nesting_.begin(count, indefinite, isMap, maxDepth_)) {
+    fail(WellFormedError::kMaxDepthExceeded);
+    return;
+  }
+
+  if (isMap) {
+    visitor_.onBeginMap(length, indefinite);
+  } else {
+    visitor_.onBeginArray(length, indefinite);
+  }
+}
+
+void PushParser::processBreak() {
+  if (nesting_.isTagged()) {
+    fail(WellFormedError::kSyntaxError);
+    return;
+  }
+
+  if (indefiniteString_ != 0) {
+    if (indefiniteString_ == kBytes) {
+      visitor_.onEndBytes();
+    } else {
+      visitor_.onEndText();
+    }
+    indefiniteString_ = 0;
+    endItem();
+    return;
+  }
+
+  if (!nesting_.endBreak()) {
+    fail(WellFormedError::kSyntaxError);
+    return;
+  }
+  visitor_.onEnd();
+  endItem();
+}
+
+void PushParser::endStringChunk() {
+  state_ = State::kHead;
+  if (indefiniteString_ != 0) {
+    // Only the whole string is an item
+    return;
+  }
+  if ((initialByte_ >> 5) == kBytes) {
+    visitor_.onEndBytes();
+  } else {
+    visitor_.onEndText();
+  }
+  endItem();
+}
+
+void PushParser::endItem() {
+  for (int ended = nesting_.endItem(); ended > 0; ended--) {
+    visitor_.onEnd();
+  }
+  if (nesting_.depth() == 0) {
+    itemCount_++;
+  }
+}
+
+bool PushParser::fail(WellFormedError err) {
+  if (error_ == WellFormedError::kNoError) {
+    error_ = err;
+  }
+  return false;
+}
+
+}  // namespace cbor
+}  // namespace qindesign
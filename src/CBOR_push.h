@@ -0,0 +1,158 @@
+// CBOR_push.h defines a parser that is fed data as it arrives instead of
+// reading it from a stream.
+// This is part of libCBOR.
+// (c) 2017 Shawn Silverman
+
+#ifndef CBOR_PUSH_H_
+#define CBOR_PUSH_H_
+
+// C++ includes
+#ifdef __has_include
+#if __has_include(<cstddef>)
+#include <cstddef>
+#else
+#include <stddef.h>
+#endif
+#if __has_include(<cstdint>)
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+#else
+#include <cstddef>
+#include <cstdint>
+#endif
+
+// Project includes
+#include "CBOR.h"
+#include "CBOR_nesting.h"
+#include "CBOR_visitor.h"
+
+namespace qindesign {
+namespace cbor {
+
+// PushParser parses CBOR data that is fed to it in chunks having arbitrary
+// boundaries, for example, packets from a network connection. Partial heads
+// are kept across calls to feed(), and string data is passed to the visitor
+// directly from the fed chunks, so no reassembly buffer is needed.
+//
+// Any number of top-level data items can be fed, one after the other. The
+// parser checks that the data is well-formed, using the same rules as
+// Reader::isWellFormed(), but it does not validate the contents of tags or
+// text.
+//
+// For example:
+//   MyVisitor v;
+//   PushParser p{v};
+//   while (connected) {
+//     size_t len = client.read(buf, sizeof(buf));
+//     if (!p.feed(buf, len)) {
+//       // Handle the error
+//     }
+//   }
+class PushParser {
+ public:
+  // Creates a new parser that sends events to the given visitor. The visitor
+  // must remain valid for the lifetime of this object. Arrays and maps may
+  // be nested up to maxDepth levels, which is limited to kMaxDepth.
+  PushParser(Visitor &visitor, int maxDepth = kMaxDepth)
+      : visitor_(visitor),
+        maxDepth_((maxDepth < 0) ? 0
+                  : (maxDepth > kMaxDepth) ? kMaxDepth : maxDepth),
+        state_(State::kHead),
+        error_(WellFormedError::kNoError),
+        initialByte_(0),
+        argBytes_(0),
+        arg_(0),
+        payloadRemaining_(0),
+        indefiniteString_(0),
+        itemCount_(0) {}
+
+  ~PushParser() = default;
+
+  // Parses the given bytes, sending events to the visitor as data items are
+  // recognized. This returns false if the data is not well-formed, in which
+  // case getError() indicates why. Once an error occurs, all further data
+  // is ignored until reset() is called.
+  bool feed(const uint8_t *data, size_t len);
+
+  // Returns the reason the data is not well-formed, or
+  // WellFormedError::kNoError if there was no error.
+  WellFormedError getError() const {
+    return error_;
+  }
+
+  // Returns whether the parser is between top-level data items; that is,
+  // whether all the data fed so far makes up complete items.
+  bool isBetweenItems() const {
+    return state_ == State::kHead && nesting_.depth() == 0 &&
+           !nesting_.isTagged() && indefiniteString_ == 0;
+  }
+
+  // Returns the number of complete top-level data items parsed so far. This
+  // can be checked from within the visitor; for example, a top-level item
+  // has just been completed if this value changes after an event.
+  size_t getItemCount() const {
+    return itemCount_;
+  }
+
+  // Returns the current array and map nesting depth. This is zero at the
+  // top level.
+  int getDepth() const {
+    return nesting_.depth();
+  }
+
+  // Clears all state and any error so that a new sequence of items can
+  // be parsed.
+  void reset();
+
+ private:
+  enum class State {
+    kHead,      // Waiting for an initial byte
+    kArgument,  // Collecting the bytes of an argument
+    kPayload,   // Passing string data to the visitor
+  };
+
+  // Handles a data item whose head is complete.
+  void processHead();
+
+  // Handles the start of an array or map.
+  void beginContainer(bool isMap, uint64_t length, bool indefinite);
+
+  // Handles a break.
+  void processBreak();
+
+  // Handles the end of a complete string chunk.
+  void endStringChunk();
+
+  // Records the end of a complete data item, ending any definite-length
+  // containers that are now complete.
+  void endItem();
+
+  // Sets the error, if not already set, and returns false.
+  bool fail(WellFormedError err);
+
+  Visitor &visitor_;
+  const int maxDepth_;
+
+  State state_;
+  WellFormedError error_;
+
+  uint8_t initialByte_;
+  int argBytes_;  // Argument bytes still to be collected
+  uint64_t arg_;
+  uint64_t payloadRemaining_;
+
+  // The major type of the current indefinite-length string, or zero if not
+  // inside one
+  uint8_t indefiniteString_;
+
+  detail::NestingStack nesting_;
+
+  size_t itemCount_;
+};
+
+}  // namespace cbor
+}  // namespace qindesign
+
+#endif  // CBOR_PUSH_H_
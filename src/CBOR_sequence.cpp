@@ -0,0 +1,123 @@
+// CBOR_sequence.cpp is part of libCBOR.
+// (c) 2017 Shawn Silverman
+
+#include "CBOR_sequence.h"
+
+namespace qindesign {
+namespace cbor {
+
+// The encoded self-describe tag.
+static constexpr uint8_t kSelfDescribe[3]{0xd9, 0xd9, 0xf7};
+
+bool SequenceIterator::next(size_t *start, size_t *length) {
+  error_ = WellFormedError::kNoError;
+  while (!atEnd()) {
+    size_t len = checkItem();
+    if (len > 0) {
+      *start = offset_;
+      *length = len;
+      offset_ += len;
+      return true;
+    }
+    if (!resync_ || !resync()) {
+      return false;
+    }
+  }
+  return false;
+}
+
+bool SequenceIterator::seek(size_t offset) {
+  if (in_ == nullptr) {
+    if (offset > size_) {
+      return false;
+    }
+  } else if (seek_ == nullptr || !seek_(offset, seekArg_)) {
+    return false;
+  }
+  offset_ = offset;
+  return true;
+}
+
+size_t SequenceIterator::checkItem() {
+  size_t len;
+  if (in_ == nullptr) {
+    BufferReader r{&data_[offset_], size_ - offset_};
+    if (!r.isWellFormed()) {
+      error_ = r.getWellFormedError();
+      return 0;
+    }
+    len = r.getIndex();
+  } else {
+    Reader r{*in_};
+    if (!r.isWellFormed()) {
+      error_ = r.getWellFormedError();
+      return 0;
+    }
+    len = r.getReadSize();
+  }
+  return len;
+}
+
+bool SequenceIterator::atEnd() {
+  if (in_ == nullptr) {
+    return offset_ >= size_;
+  }
+  return in_->peek() < 0;
+}
+
+bool SequenceIterator::resync() {
+  size_t from = offset_ + 1;
+
+  if (in_ == nullptr) {
+    for (size_t i = from; i + sizeof(kSelfDescribe) <= size_; i++) {
+      if (data_[i] == kSelfDescribe[0] && data_[i + 1] == kSelfDescribe[1] &&
+          data_[i + 2] == kSelfDescribe[2]) {
+        skipped_ += i - offset_;
+        offset_ = i;
+        return true;
+      }
+    }
+    skipped_ += size_ - offset_;
+    offset_ = size_;
+    return false;
+  }
+
+  if (seek_ == nullptr || !seek_(from, seekArg_)) {
+    return false;
+  }
+
+  // Match the tag bytes as they arrive; since the first two bytes are the
+  // same, a mismatch while matching the last one can still leave a partial
+  // match
+  size_t pos = from;
+  size_t matched = 0;
+  int b;
+  while ((b = in_->read()) >= 0) {
+    pos++;
+    if (b == kSelfDescribe[matched]) {
+      if (++matched == sizeof(kSelfDescribe)) {
+        size_t found = pos - sizeof(kSelfDescribe);
+        if (!seek_(found, seekArg_)) {
+          skipped_ += pos - offset_;
+          offset_ = pos;
+          return false;
+        }
+        skipped_ += found - offset_;
+        offset_ = found;
+        return true;
+      }
+    } else if (b == kSelfDescribe[0]) {
+      if (matched != 2) {
+        matched = 1;
+      }
+    } else {
+      matched = 0;
+    }
+  }
+  skipped_ += pos - offset_;
+  offset_ = pos;
+  return false;
+}
+
+}  // namespace cbor
+}  // namespace qindesign
@@ -0,0 +1,180 @@
+// CBOR_sequence.h defines an iterator over a CBOR sequence, a series of
+// top-level data items stored back to back (RFC 8742).
+// This is part of libCBOR.
+// (c) 2017 Shawn Silverman
+
+#ifndef CBOR_SEQUENCE_H_
+#define CBOR_SEQUENCE_H_
+
+// C++ includes
+#ifdef __has_include
+#if __has_include(<cstddef>)
+#include <cstddef>
+#else
+#include <stddef.h>
+#endif
+#if __has_include(<cstdint>)
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+#else
+#include <cstddef>
+#include <cstdint>
+#endif
+
+// Other includes
+#include <Stream.h>
+
+// Project includes
+#include "CBOR.h"
+
+namespace qindesign {
+namespace cbor {
+
+// SequenceIterator finds the byte range of each top-level data item in a CBOR
+// sequence, for example, a log of records appended to EEPROM or to a file.
+// Each item is checked with the same iterative validator as
+// Reader::isWellFormed(), and the data is read once, so walking the whole
+// sequence takes linear time.
+//
+// The offset of the next item can be saved with getOffset() and passed back
+// later, so that a log can be resumed without re-reading what came before.
+//
+// If resynchronization is enabled, an item that's not well-formed is
+// skipped by scanning forward for the next self-describe tag (see
+// kSelfDescribeTag), so writers that want their logs to be recoverable
+// should start each record with that tag. Note that a truncated last item,
+// for example, one that was being written at power loss, also counts as not
+// well-formed.
+//
+// The source is either a buffer or a stream. Streams need a SeekFunction to
+// be able to resume from an offset or to resynchronize, and all their data
+// should already be available, because running out of data partway through
+// an item is an error.
+//
+// For example:
+//   EEPROMStream es{EEPROM.length(), 0};
+//   SequenceIterator it{es, 0, &seekEEPROM, &es};
+//   size_t start;
+//   size_t length;
+//   while (it.next(&start, &length)) {
+//     // Process the record in [start, start + length)
+//   }
+//   if (it.getError() != WellFormedError::kNoError) {
+//     // Append new records at it.getOffset()
+//   }
+class SequenceIterator {
+ public:
+  // Moves a stream to the given offset from the start of the sequence. This
+  // returns whether the move succeeded. The arg parameter is the value that
+  // was passed to the constructor.
+  using SeekFunction = bool (*)(size_t offset, void *arg);
+
+  // Creates a new iterator over the sequence in the given buffer, starting
+  // at the given offset. The buffer must remain valid for the lifetime of
+  // this object.
+  SequenceIterator(const uint8_t *data, size_t size, size_t offset = 0)
+      : in_(nullptr),
+        seek_(nullptr),
+        seekArg_(nullptr),
+        data_(data),
+        size_((data == nullptr) ? 0 : size),
+        offset_(0),
+        skipped_(0),
+        error_(WellFormedError::kNoError),
+        resync_(false) {
+    offset_ = (offset < size_) ? offset : size_;
+  }
+
+  // Creates a new iterator over the sequence in the given stream, which is
+  // already positioned at the given offset. The optional seek function is
+  // used by seek() and for resynchronization. The stream must remain valid
+  // for the lifetime of this object.
+  SequenceIterator(Stream &in, size_t offset = 0, SeekFunction seek = nullptr,
+                   void *arg = nullptr)
+      : in_(&in),
+        seek_(seek),
+        seekArg_(arg),
+        data_(nullptr),
+        size_(0),
+        offset_(offset),
+        skipped_(0),
+        error_(WellFormedError::kNoError),
+        resync_(false) {}
+
+  ~SequenceIterator() = default;
+
+  // Sets whether to skip items that are not well-formed by scanning forward
+  // for the next self-describe tag. Stream sources need a seek function for
+  // this. The default is false.
+  void setResync(bool flag) {
+    resync_ = flag;
+  }
+
+  // Returns whether resynchronization is enabled.
+  bool isResync() const {
+    return resync_;
+  }
+
+  // Finds the next well-formed item and fills in its offset and length. This
+  // returns false when there are no more items, or, without
+  // resynchronization, when the next item is not well-formed. In the second
+  // case, getError() indicates why and getOffset() is the offset of the
+  // bad item.
+  bool next(size_t *start, size_t *length);
+
+  // Returns why the last item that was rejected during the most recent call
+  // to next() was not well-formed, or WellFormedError::kNoError if no item
+  // was rejected. With resynchronization, this may be set even when next()
+  // returns true.
+  WellFormedError getError() const {
+    return error_;
+  }
+
+  // Returns the offset of the next item. This can be saved and later passed
+  // to seek() or to a constructor to resume iteration.
+  size_t getOffset() const {
+    return offset_;
+  }
+
+  // Returns the total number of bytes skipped by resynchronization.
+  size_t getSkippedSize() const {
+    return skipped_;
+  }
+
+  // Moves to the given offset. This returns false if the offset is past the
+  // end of a buffer or if the stream couldn't be moved, in which case the
+  // offset is unchanged.
+  bool seek(size_t offset);
+
+ private:
+  // Checks the item at the current offset and returns its length, or zero
+  // if it's not well-formed, in which case error_ is set.
+  size_t checkItem();
+
+  // Returns whether there's no more data at the current offset.
+  bool atEnd();
+
+  // Scans forward from just past the current offset for the next
+  // self-describe tag and moves there. This returns false if there isn't
+  // one, in which case the offset is left at the end of the data.
+  bool resync();
+
+  Stream *in_;
+  SeekFunction seek_;
+  void *seekArg_;
+
+  const uint8_t *data_;
+  size_t size_;
+
+  size_t offset_;
+  size_t skipped_;
+  WellFormedError error_;
+  bool resync_;
+};
+
+}  // namespace cbor
+}  // namespace qindesign
+
+#endif  // CBOR_SEQUENCE_H_
@@ -3,12 +3,51 @@
 
 #include "CBOR_streams.h"
 
+// C++ includes
+#ifdef __has_include
+#if __has_include(<climits>)
+#include <climits>
+#else
+#include <limits.h>
+#endif
+#if __has_include(<cstring>)
+#include <cstring>
+#else
+#include <string.h>
+#endif
+#else
+#include <climits>
+#include <cstring>
+#endif
+
 // Other includes
 #include <EEPROM.h>
+#if !QINDESIGN_CBOR_HAS_ATOMIC && defined(__AVR__)
+#include <util/atomic.h>
+#endif
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+#elif defined(ESP8266)
+#include <pgmspace.h>
+#endif
+
+// Project includes
+#include "CBOR.h"
 
 namespace qindesign {
 namespace cbor {
 
+// Writes a byte to the EEPROM only if it's different from what's there.
+static void updateEEPROM(int address, uint8_t b) {
+#if !defined(ESP8266) && !defined(ESP32)
+  EEPROM.update(address, b);
+#else
+  if (EEPROM.read(address) != b) {
+    EEPROM.write(address, b);
+  }
+#endif
+}
+
 int BytesStream::available() {
   if (index_ >= length_) {
     return 0;
@@ -43,6 +82,49 @@ int BytesStream::peek() {
   return b_[index_];
 }
 
+int FlashStream::available() {
+  if (index_ >= size_) {
+    return 0;
+  }
+  size_t n = size_ - index_;
+  return (n > INT_MAX) ? INT_MAX : n;
+}
+
+int FlashStream::read() {
+  int b = peek();
+  if (b >= 0) {
+    index_++;
+  }
+  return b;
+}
+
+int FlashStream::peek() {
+  if (index_ >= size_) {
+    return -1;
+  }
+#if QINDESIGN_CBOR_PGM_READ
+  return pgm_read_byte(&data_[index_]);
+#else
+  return data_[index_];
+#endif
+}
+
+size_t FlashStream::readBytes(uint8_t *buffer, size_t length) {
+  if (index_ >= size_) {
+    return 0;
+  }
+  if (length > size_ - index_) {
+    length = size_ - index_;
+  }
+#if QINDESIGN_CBOR_PGM_READ
+  memcpy_P(buffer, &data_[index_], length);
+#else
+  memcpy(buffer, &data_[index_], length);
+#endif
+  index_ += length;
+  return length;
+}
+
 size_t BytesPrint::write(uint8_t b) {
   if (index_ < size_) {
     buf_[index_++] = b;
@@ -52,6 +134,262 @@ size_t BytesPrint::write(uint8_t b) {
   return 0;
 }
 
+constexpr size_t BytesPrint::kNoDeferred;
+
+BytesPrint::DeferredHead BytesPrint::beginDeferred(uint8_t majorType) {
+  size_t index = index_;
+  if (write(majorType << 5) == 0) {
+    return DeferredHead{kNoDeferred, deferred_, majorType};
+  }
+  DeferredHead head{index, deferred_, majorType};
+  deferred_ = index;
+  return head;
+}
+
+bool BytesPrint::endDeferred(uint8_t majorType, const DeferredHead &head,
+                             uint64_t count) {
+  // Only the innermost open head of the same type may be ended
+  if (head.index_ == kNoDeferred || head.index_ != deferred_ ||
+      head.majorType_ != majorType) {
+    return false;
+  }
+  size_t index = head.index_;
+
+  size_t argSize = encodedHeadSize(count) - 1;
+  if (argSize > 0) {
+    if (argSize > size_ - index_) {
+      setWriteError();
+      return false;
+    }
+    memmove(&buf_[index + 1 + argSize], &buf_[index + 1],
+            index_ - (index + 1));
+    index_ += argSize;
+  }
+
+  // The additional info is the count itself or 24 to 27 for 1 to 8 bytes
+  uint8_t ai;
+  switch (argSize) {
+    case 0:
+      ai = count;
+      break;
+    case 1:
+      ai = 24;
+      break;
+    case 2:
+      ai = 25;
+      break;
+    case 4:
+      ai = 26;
+      break;
+    default:
+      ai = 27;
+      break;
+  }
+  buf_[index] = (majorType << 5) | ai;
+  for (size_t i = argSize; i > 0; i--) {
+    buf_[index + i] = static_cast<uint8_t>(count);
+    count >>= 8;
+  }
+  deferred_ = head.outer_;
+  return true;
+}
+
+// ***************************************************************************
+//  RingBufferStream
+// ***************************************************************************
+
+RingBufferStream::RingBufferStream(uint8_t *buf, size_t size)
+    : buf_(buf),
+      mask_(0),
+      head_(0),
+      tail_(0) {
+  if (buf == nullptr || size == 0) {
+    buf_ = nullptr;
+    return;
+  }
+  size_t capacity = 1;
+  while (capacity <= size / 2) {
+    capacity <<= 1;
+  }
+  mask_ = capacity - 1;
+}
+
+size_t RingBufferStream::acquire(const Index &index) {
+#if QINDESIGN_CBOR_HAS_ATOMIC
+  return index.load(std::memory_order_acquire);
+#elif defined(__AVR__)
+  // Multi-byte loads aren't atomic on 8-bit processors
+  size_t value;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    value = index;
+  }
+  return value;
+#else
+  size_t value = index;
+  __sync_synchronize();
+  return value;
+#endif
+}
+
+void RingBufferStream::release(Index &index, size_t value) {
+#if QINDESIGN_CBOR_HAS_ATOMIC
+  index.store(value, std::memory_order_release);
+#elif defined(__AVR__)
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    index = value;
+  }
+#else
+  __sync_synchronize();
+  index = value;
+#endif
+}
+
+int RingBufferStream::available() {
+  if (buf_ == nullptr) {
+    return 0;
+  }
+  size_t n = acquire(head_) - tail_;
+  return (n > INT_MAX) ? INT_MAX : n;
+}
+
+int RingBufferStream::read() {
+  if (buf_ == nullptr) {
+    return -1;
+  }
+  size_t tail = tail_;
+  if (acquire(head_) == tail) {
+    return -1;
+  }
+  uint8_t b = buf_[tail & mask_];
+  release(tail_, tail + 1);
+  return b;
+}
+
+int RingBufferStream::peek() {
+  if (buf_ == nullptr) {
+    return -1;
+  }
+  size_t tail = tail_;
+  if (acquire(head_) == tail) {
+    return -1;
+  }
+  return buf_[tail & mask_];
+}
+
+size_t RingBufferStream::readBytes(uint8_t *buffer, size_t length) {
+  if (buf_ == nullptr) {
+    return 0;
+  }
+  size_t tail = tail_;
+  size_t n = acquire(head_) - tail;
+  if (n > length) {
+    n = length;
+  }
+  size_t index = tail & mask_;
+  size_t first = mask_ + 1 - index;
+  if (first > n) {
+    first = n;
+  }
+  memcpy(buffer, &buf_[index], first);
+  memcpy(&buffer[first], buf_, n - first);
+  release(tail_, tail + n);
+  return n;
+}
+
+int RingBufferStream::availableForWrite() {
+  if (buf_ == nullptr) {
+    return 0;
+  }
+  size_t n = mask_ + 1 - (head_ - acquire(tail_));
+  return (n > INT_MAX) ? INT_MAX : n;
+}
+
+size_t RingBufferStream::write(uint8_t b) {
+  size_t head = head_;
+  if (buf_ == nullptr || head - acquire(tail_) > mask_) {
+    setWriteError();
+    return 0;
+  }
+  buf_[head & mask_] = b;
+  release(head_, head + 1);
+  return 1;
+}
+
+size_t RingBufferStream::write(const uint8_t *buffer, size_t size) {
+  if (buf_ == nullptr) {
+    if (size > 0) {
+      setWriteError();
+    }
+    return 0;
+  }
+  size_t head = head_;
+  size_t n = mask_ + 1 - (head - acquire(tail_));
+  if (n < size) {
+    setWriteError();
+  } else {
+    n = size;
+  }
+  size_t index = head & mask_;
+  size_t first = mask_ + 1 - index;
+  if (first > n) {
+    first = n;
+  }
+  memcpy(&buf_[index], buffer, first);
+  memcpy(buf_, &buffer[first], n - first);
+  release(head_, head + n);
+  return n;
+}
+
+// ***************************************************************************
+//  BufferedPrint
+// ***************************************************************************
+
+size_t BufferedPrint::write(uint8_t b) {
+  if (bufSize_ == 0) {
+    return writeOut(&b, 1);
+  }
+  buf_[count_++] = b;
+  if (count_ >= bufSize_) {
+    flushBuffer();
+  }
+  return 1;
+}
+
+size_t BufferedPrint::write(const uint8_t *buffer, size_t size) {
+  if (size == 0) {
+    return 0;
+  }
+  if (size > bufSize_ - count_) {
+    flushBuffer();
+    if (size >= bufSize_) {
+      return writeOut(buffer, size);
+    }
+  }
+  memcpy(&buf_[count_], buffer, size);
+  count_ += size;
+  if (count_ >= bufSize_) {
+    flushBuffer();
+  }
+  return size;
+}
+
+void BufferedPrint::flushBuffer() {
+  if (count_ == 0) {
+    return;
+  }
+  size_t n = count_;
+  count_ = 0;
+  writeOut(buf_, n);
+}
+
+size_t BufferedPrint::writeOut(const uint8_t *buffer, size_t size) {
+  size_t written = out_.write(buffer, size);
+  if (written < size) {
+    setWriteError();
+  }
+  return written;
+}
+
 int EEPROMStream::available() {
   if (static_cast<unsigned int>(address_) >= size_) {
     return 0;
@@ -75,14 +413,7 @@ int EEPROMStream::peek() {
 
 size_t EEPROMPrint::write(uint8_t b) {
   if (static_cast<unsigned int>(address_) < size_) {
-#if !defined(ESP8266) && !defined(ESP32)
-    EEPROM.update(address_++, b);
-#else
-    if (EEPROM.read(address_) != b) {
-      EEPROM.write(address_, b);
-    }
-    address_++;
-#endif
+    updateEEPROM(address_++, b);
     return 1;
   }
   setWriteError();
@@ -92,5 +423,133 @@ size_t EEPROMPrint::write(uint8_t b) {
 void EEPROMPrint::flush() {
 }
 
+int BufferedEEPROMStream::available() {
+  if (static_cast<unsigned int>(address_) >= size_) {
+    return 0;
+  }
+  return size_ - address_;
+}
+
+int BufferedEEPROMStream::read() {
+  if (static_cast<unsigned int>(address_) >= size_) {
+    return -1;
+  }
+  if (bufSize_ == 0) {
+    return EEPROM.read(address_++);
+  }
+  fill();
+  return buf_[address_++ - blockStart_];
+}
+
+int BufferedEEPROMStream::peek() {
+  if (static_cast<unsigned int>(address_) >= size_) {
+    return -1;
+  }
+  if (bufSize_ == 0) {
+    return EEPROM.read(address_);
+  }
+  fill();
+  return buf_[address_ - blockStart_];
+}
+
+void BufferedEEPROMStream::fill() {
+  if (blockLen_ > 0 &&
+      address_ >= blockStart_ &&
+      static_cast<size_t>(address_ - blockStart_) < blockLen_) {
+    return;
+  }
+  blockStart_ = address_ - (address_ % bufSize_);
+  blockLen_ = size_ - blockStart_;
+  if (blockLen_ > bufSize_) {
+    blockLen_ = bufSize_;
+  }
+#if defined(__AVR__)
+  eeprom_read_block(buf_, reinterpret_cast<const void *>(blockStart_),
+                    blockLen_);
+#else
+  for (size_t i = 0; i < blockLen_; i++) {
+    buf_[i] = EEPROM.read(blockStart_ + i);
+  }
+#endif
+}
+
+size_t BufferedEEPROMPrint::write(uint8_t b) {
+  if (static_cast<unsigned int>(address_) >= size_) {
+    setWriteError();
+    return 0;
+  }
+  if (bufSize_ == 0) {
+    updateEEPROM(address_++, b);
+    return 1;
+  }
+  buf_[count_++] = b;
+  address_++;
+  if (count_ >= bufSize_ || (address_ % bufSize_) == 0) {
+    flushBuffer();
+  }
+  return 1;
+}
+
+size_t BufferedEEPROMPrint::write(const uint8_t *buffer, size_t size) {
+  size_t written = 0;
+  while (written < size) {
+    if (static_cast<unsigned int>(address_) >= size_) {
+      setWriteError();
+      break;
+    }
+    if (bufSize_ == 0) {
+      updateEEPROM(address_++, buffer[written++]);
+      continue;
+    }
+
+    // Copy up to the next flush boundary
+    size_t n = bufSize_ - (address_ % bufSize_);
+    if (n > bufSize_ - count_) {
+      n = bufSize_ - count_;
+    }
+    if (n > size_ - address_) {
+      n = size_ - address_;
+    }
+    if (n > size - written) {
+      n = size - written;
+    }
+    memcpy(&buf_[count_], &buffer[written], n);
+    count_ += n;
+    address_ += n;
+    written += n;
+    if (count_ >= bufSize_ || (address_ % bufSize_) == 0) {
+      flushBuffer();
+    }
+  }
+  return written;
+}
+
+void BufferedEEPROMPrint::flushBuffer() {
+  if (count_ == 0) {
+    return;
+  }
+  int address = address_ - count_;
+#if defined(__AVR__)
+  eeprom_update_block(buf_, reinterpret_cast<void *>(address), count_);
+#elif defined(ESP8266) || defined(ESP32)
+  // Commit once for the whole buffer, and only if something changed
+  bool changed = false;
+  for (size_t i = 0; i < count_; i++) {
+    if (EEPROM.read(address + i) != buf_[i]) {
+      EEPROM.write(address + i, buf_[i]);
+      changed = true;
+    }
+  }
+  if (changed) {
+    EEPROM.commit();
+  }
+#else
+  for (size_t i = 0; i < count_; i++) {
+    updateEEPROM(address + i, buf_[i]);
+  }
+#endif
+  count_ = 0;
+}
+
 }  // namespace cbor
 }  // namespace qindesign
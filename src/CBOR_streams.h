@@ -6,10 +6,33 @@
 #ifndef CBOR_STREAMS_H_
 #define CBOR_STREAMS_H_
 
+// C++ includes
+#ifdef __has_include
+#if __has_include(<atomic>)
+#include <atomic>
+#define QINDESIGN_CBOR_HAS_ATOMIC 1
+#endif
+#if __has_include(<cstddef>)
+#include <cstddef>
+#else
+#include <stddef.h>
+#endif
+#else
+#include <cstddef>
+#endif
+
 // Other includes
 #include <Print.h>
 #include <Stream.h>
 
+// Whether data in program memory must be read with pgm_read_byte() instead
+// of being addressed directly.
+#if defined(__AVR__) || defined(ESP8266)
+#define QINDESIGN_CBOR_PGM_READ 1
+#else
+#define QINDESIGN_CBOR_PGM_READ 0
+#endif
+
 namespace qindesign {
 namespace cbor {
 
@@ -55,6 +78,13 @@ class BytesStream : public Stream {
     waiting_ = waitStates_;
   }
 
+  // Sets the current index into the byte array. An index past the end
+  // means that end-of-stream has been reached.
+  void seek(size_t index) {
+    index_ = index;
+    waiting_ = waitStates_;
+  }
+
   // Returns the current index into the byte array. This indicates how many
   // bytes were read.
   size_t getIndex() const {
@@ -70,12 +100,120 @@ class BytesStream : public Stream {
   unsigned int waiting_;
 };
 
+// FlashStream reads data that's stored in program memory; for example, a
+// large table declared PROGMEM or placed in memory-mapped flash, so that it
+// can be read in place instead of being copied into RAM. Where program memory
+// needs special access, on AVR and ESP8266, the data is read with
+// pgm_read_byte() and memcpy_P(); on AVR, it must be in the lower 64KiB.
+// Everywhere else, it's read directly.
+//
+// Where the data is directly addressable, getData() can also be used with the
+// buffer-based classes, for example a BufferReader or a Document, whose bytes
+// and text then refer to the flash contents without copying them.
+//
+// For example:
+//   static const uint8_t kTable[] PROGMEM = { ... };
+//   FlashStream fs{kTable, sizeof(kTable)};
+//   Reader r{fs};
+class FlashStream : public Stream {
+ public:
+  // Creates a new stream over the given program memory data.
+  FlashStream(const uint8_t *data, size_t size)
+      : data_(data),
+        size_((data == nullptr) ? 0 : size),
+        index_(0) {}
+
+  ~FlashStream() = default;
+
+  int available() override;
+  int read() override;
+  int peek() override;
+
+  // Reads up to length bytes without waiting and returns the number of bytes
+  // read. Note that this hides Stream::readBytes(); a Reader uses that
+  // version, one byte at a time.
+  size_t readBytes(uint8_t *buffer, size_t length);
+  size_t readBytes(char *buffer, size_t length) {
+    return readBytes(reinterpret_cast<uint8_t *>(buffer), length);
+  }
+
+  // Does nothing and returns zero.
+  size_t write(uint8_t b) final {
+    return 0;
+  }
+
+  // Does nothing.
+  void flush() final {
+  }
+
+  // Resets the stream back to the beginning.
+  void reset() {
+    index_ = 0;
+  }
+
+  // Sets the current offset into the data. An offset past the end means
+  // that end-of-stream has been reached.
+  void seek(size_t offset) {
+    index_ = offset;
+  }
+
+  // Returns the current offset into the data. This indicates how many bytes
+  // were read.
+  size_t getIndex() const {
+    return index_;
+  }
+
+  // Returns the size of the data.
+  size_t size() const {
+    return size_;
+  }
+
+  // Returns a pointer to the data if it can be addressed directly, and
+  // nullptr if it must be read with pgm_read_byte().
+  const uint8_t *getData() const {
+#if QINDESIGN_CBOR_PGM_READ
+    return nullptr;
+#else
+    return data_;
+#endif
+  }
+
+ private:
+  const uint8_t *data_;
+  const size_t size_;
+  size_t index_;
+};
+
 // Print implementation for a byte buffer.
 class BytesPrint : public Print {
  public:
+  // Identifies a head reserved by beginArrayDeferred() or
+  // beginMapDeferred(). It can only be used to end that container.
+  class DeferredHead {
+   public:
+    // Returns the index of the reserved head, or ~size_t{0} if no head
+    // could be reserved.
+    size_t getIndex() const {
+      return index_;
+    }
+
+   private:
+    friend class BytesPrint;
+
+    DeferredHead(size_t index, size_t outer, uint8_t majorType)
+        : index_(index),
+          outer_(outer),
+          majorType_(majorType) {}
+
+    size_t index_;
+    size_t outer_;  // The enclosing reserved head
+    uint8_t majorType_;
+  };
+
   BytesPrint(uint8_t *b, size_t size)
       : buf_(b),
-        index_(0) {
+        index_(0),
+        deferred_(kNoDeferred) {
     if (b == nullptr) {
       size = 0;
     }
@@ -88,9 +226,11 @@ class BytesPrint : public Print {
   // not hold the byte.
   size_t write(uint8_t b) override;
 
-  // Resets the stream back to the beginning.
+  // Resets the stream back to the beginning. This also discards any
+  // reserved heads; their tokens must not be used afterwards.
   void reset() {
     index_ = 0;
+    deferred_ = kNoDeferred;
   }
 
   // Returns the current index into the byte array. This indicates how many
@@ -99,10 +239,255 @@ class BytesPrint : public Print {
     return index_;
   }
 
+  // Starts an array whose length isn't known yet by reserving a one-byte
+  // head, and returns a token for that head. The items are then written
+  // normally, and endArrayDeferred() fills in the final count. This produces
+  // a definite-length array in a single pass, which is smaller and quicker
+  // to process than an indefinite-length one.
+  //
+  // Deferred arrays and maps may be nested, as long as the innermost one is
+  // ended first. Note that because the heads are written here and not by
+  // a Writer, any Writer's write size won't include them; use getIndex()
+  // for the total size.
+  DeferredHead beginArrayDeferred() {
+    return beginDeferred(4);
+  }
+
+  // Writes the head for the array started with beginArrayDeferred(). If the
+  // count needs a head larger than one byte then the items are shifted with
+  // a single move to make room. This returns false, and also sets a write
+  // error if there's no more room, if the head could not be written. The
+  // head must be the innermost one that's still open, and it must be for an
+  // array; otherwise, this returns false and changes nothing.
+  bool endArrayDeferred(const DeferredHead &head, uint64_t count) {
+    return endDeferred(4, head, count);
+  }
+
+  // Map versions of beginArrayDeferred() and endArrayDeferred(). The count
+  // is the number of key/value pairs.
+  DeferredHead beginMapDeferred() {
+    return beginDeferred(5);
+  }
+  bool endMapDeferred(const DeferredHead &head, uint64_t count) {
+    return endDeferred(5, head, count);
+  }
+
  private:
+  // Indicates that no head is reserved.
+  static constexpr size_t kNoDeferred = ~size_t{0};
+
+  // Reserves the head for a container having the given major type.
+  DeferredHead beginDeferred(uint8_t majorType);
+
+  // Writes the given reserved head.
+  bool endDeferred(uint8_t majorType, const DeferredHead &head,
+                   uint64_t count);
+
   uint8_t *buf_;
   size_t size_;
   size_t index_;
+
+  // The innermost reserved head that hasn't been ended yet
+  size_t deferred_;
+};
+
+// Print implementation that only counts the bytes written and discards
+// them. This is useful for determining the encoded size of some data before
+// writing it; for example, to allocate an exact buffer or to use
+// definite-length bytes, text, arrays, or maps.
+class CountingPrint : public Print {
+ public:
+  CountingPrint() : count_(0) {}
+
+  ~CountingPrint() = default;
+
+  // Counts the byte.
+  size_t write(uint8_t b) override {
+    count_++;
+    return 1;
+  }
+
+  // Counts the bytes.
+  size_t write(const uint8_t *buffer, size_t size) override {
+    count_ += size;
+    return size;
+  }
+
+  // Resets the count to zero.
+  void reset() {
+    count_ = 0;
+  }
+
+  // Returns the number of bytes written.
+  size_t getCount() const {
+    return count_;
+  }
+
+ private:
+  size_t count_;
+};
+
+// RingBufferStream passes bytes from one context to another through a
+// circular buffer; for example, from an interrupt handler or a task on
+// another core that writes data to a Reader in the main loop. There must be
+// only one producer, which uses the Print functions, and one consumer, which
+// uses the Stream functions. Neither needs a lock or has to disable
+// interrupts: each side only changes its own index, and the indexes are
+// atomic where <atomic> is available.
+//
+// The capacity is the largest power of two that fits in the buffer. Writes
+// that don't fit are cut short and set the write error; they never
+// overwrite unread data.
+//
+// For example:
+//   uint8_t buf[256];
+//   RingBufferStream rb{buf, sizeof(buf)};
+//   Writer w{rb};  // Producer
+//   Reader r{rb};  // Consumer
+class RingBufferStream : public Stream {
+ public:
+  // Creates a new ring buffer over the given array, which must remain valid
+  // for the lifetime of this object.
+  RingBufferStream(uint8_t *buf, size_t size);
+
+  ~RingBufferStream() = default;
+
+  // Consumer functions
+
+  // Returns the number of bytes that can be read.
+  int available() override;
+
+  int read() override;
+  int peek() override;
+
+  // Reads up to length bytes without waiting, copying them in at most two
+  // contiguous spans, and returns the number of bytes read. Note that this
+  // hides Stream::readBytes(), which waits for the stream's timeout; a
+  // Reader uses that version, one byte at a time.
+  size_t readBytes(uint8_t *buffer, size_t length);
+  size_t readBytes(char *buffer, size_t length) {
+    return readBytes(reinterpret_cast<uint8_t *>(buffer), length);
+  }
+
+  // Producer functions
+
+  // Returns the number of bytes that can be written without overflowing.
+  int availableForWrite();
+
+  // Writes a byte. This sets the write error and returns zero if the buffer
+  // is full.
+  size_t write(uint8_t b) override;
+
+  // Writes bytes, copying them in at most two contiguous spans, and returns
+  // the number of bytes written. This sets the write error if not all the
+  // bytes fit.
+  size_t write(const uint8_t *buffer, size_t size) override;
+
+  // Does nothing.
+  void flush() final {
+  }
+
+  // Returns the capacity, which is a power of two. This will be zero if the
+  // buffer is null or empty.
+  size_t capacity() const {
+    return mask_ + (buf_ == nullptr ? 0 : 1);
+  }
+
+ private:
+#if QINDESIGN_CBOR_HAS_ATOMIC
+  using Index = std::atomic<size_t>;
+#else
+  using Index = volatile size_t;
+#endif
+
+  // Loads the other side's index, making its data visible.
+  static size_t acquire(const Index &index);
+
+  // Stores this side's index, publishing its data.
+  static void release(Index &index, size_t value);
+
+  uint8_t *buf_;
+  size_t mask_;
+
+  // Free-running counts of the bytes written and read
+  Index head_;  // Changed only by the producer
+  Index tail_;  // Changed only by the consumer
+};
+
+// BufferedPrint collects writes in a buffer and passes them on to another
+// Print in larger pieces. This is useful for outputs where each write has a
+// cost, for example, a network client that may send a packet per write.
+//
+// The buffer is passed on when it fills, and when flush() is called, which
+// also flushes the output. Writer::flush() calls this, except on platforms
+// whose Print doesn't have flush(); on those, call this object's flush()
+// directly. The destructor also passes on any buffered bytes.
+//
+// Since bytes are accepted before they're passed on, a short write to the
+// output only sets this object's write error when the buffer is passed on,
+// and the unwritten bytes are dropped. Check getWriteError() after flush()
+// to know whether everything was written.
+//
+// For example:
+//   uint8_t buf[128];
+//   BufferedPrint bp{client, buf, sizeof(buf)};
+//   Writer w{bp};
+//   // ...write the message...
+//   w.flush();
+//   if (w.getWriteError() != 0) {
+//     // Handle the error
+//   }
+class BufferedPrint : public Print {
+ public:
+  // Creates a new buffered printer for the given output. The output and the
+  // buffer must remain valid for the lifetime of this object. A null or
+  // zero-size buffer means that every write goes straight to the output.
+  BufferedPrint(Print &out, uint8_t *buf, size_t bufSize)
+      : out_(out),
+        buf_(buf),
+        bufSize_((buf == nullptr) ? 0 : bufSize),
+        count_(0) {}
+
+  ~BufferedPrint() {
+    flushBuffer();
+  }
+
+  // Writes a byte to the buffer.
+  size_t write(uint8_t b) override;
+
+  // Writes bytes to the buffer. Sizes at least as large as the buffer are
+  // written straight to the output after any buffered bytes.
+  size_t write(const uint8_t *buffer, size_t size) override;
+
+  // Passes any buffered bytes to the output and then flushes the output.
+#if !defined(ESP8266) && !defined(ESP32) && !defined(ARDUINO_ARCH_STM32)
+  void flush() override {
+    flushBuffer();
+    out_.flush();
+  }
+#else
+  void flush() {
+    flushBuffer();
+  }
+#endif
+
+  // Returns the number of bytes waiting in the buffer.
+  size_t getBufferedCount() const {
+    return count_;
+  }
+
+ private:
+  // Passes the buffered bytes to the output. This sets the write error if
+  // they weren't all written.
+  void flushBuffer();
+
+  // Writes directly to the output, setting the write error on a short write.
+  size_t writeOut(const uint8_t *buffer, size_t size);
+
+  Print &out_;
+  uint8_t *buf_;
+  const size_t bufSize_;
+  size_t count_;
 };
 
 // Stream implementation for the EEPROM. This intended as an input-only
@@ -140,6 +525,13 @@ class EEPROMStream : public Stream {
     address_ = start_;
   }
 
+  // Sets the current address. Negative addresses are changed to zero, and
+  // addresses at or past the EEPROM size mean end-of-stream has
+  // been reached.
+  void seek(int address) {
+    address_ = (address < 0) ? 0 : address;
+  }
+
   // Returns the current address. This indicates how many bytes were read.
   int getAddress() const {
     return address_;
@@ -192,6 +584,169 @@ class EEPROMPrint : public Print {
   int address_;
 };
 
+// Buffered Stream implementation for the EEPROM. This reads ahead a block at
+// a time into a caller-provided buffer and serves reads from there. Blocks
+// are aligned to multiples of the buffer size. This is intended as an
+// input-only implementation; the required Print methods do nothing.
+//
+// If the EEPROM is modified while this stream is in use then invalidate(),
+// reset(), or seek() should be called so that the new data is seen.
+class BufferedEEPROMStream : public Stream {
+ public:
+  // Creates a new buffered stream for the EEPROM. The EEPROM size and
+  // starting address are specified, along with the buffer. If the starting
+  // address is negative then it will be changed to zero. The buffer must
+  // remain valid for the lifetime of this object. A null or zero-size
+  // buffer means that every read goes to the EEPROM.
+  BufferedEEPROMStream(size_t size, int start, uint8_t *buf, size_t bufSize)
+      : size_(size),
+        buf_(buf),
+        bufSize_((buf == nullptr) ? 0 : bufSize),
+        blockStart_(0),
+        blockLen_(0) {
+    if (start < 0) {
+      start = 0;
+    }
+    start_ = start;
+    address_ = start;
+  }
+
+  ~BufferedEEPROMStream() = default;
+
+  int available() override;
+  int read() override;
+  int peek() override;
+
+  // Does nothing and returns zero.
+  size_t write(uint8_t b) final {
+    return 0;
+  }
+
+  // Does nothing.
+  void flush() final {
+  }
+
+  // Resets the stream back to the beginning. This discards any cached data
+  // so that a re-read sees what was written in the meantime.
+  void reset() {
+    address_ = start_;
+    blockLen_ = 0;
+  }
+
+  // Sets the current address. Negative addresses are changed to zero, and
+  // addresses at or past the EEPROM size mean end-of-stream has
+  // been reached. As with reset(), this discards any cached data.
+  void seek(int address) {
+    address_ = (address < 0) ? 0 : address;
+    blockLen_ = 0;
+  }
+
+  // Discards any cached data so that the next read comes from the EEPROM.
+  void invalidate() {
+    blockLen_ = 0;
+  }
+
+  // Returns the current address. This indicates how many bytes were read.
+  int getAddress() const {
+    return address_;
+  }
+
+ private:
+  // Ensures that the block containing the current address is in the buffer.
+  // The current address must be valid.
+  void fill();
+
+  const size_t size_;
+  int start_;
+  int address_;
+
+  uint8_t *buf_;
+  const size_t bufSize_;
+  int blockStart_;
+  size_t blockLen_;  // Zero if nothing is cached
+};
+
+// Buffered Print implementation for the EEPROM. This collects written bytes
+// in a caller-provided buffer and stores them in the EEPROM when the buffer
+// is full, when the address crosses a multiple of the buffer size, or when
+// flush() is called. Choosing a buffer size equal to the EEPROM page or
+// flash sector size means that each store covers at most one page. Bytes
+// that don't change aren't rewritten.
+//
+// On AVR, each store is a single eeprom_update_block() call. On ESP8266 and
+// ESP32, whose EEPROM is emulated in flash, each store that changes any
+// bytes is followed by one EEPROM.commit(), so that a flash sector is
+// written per buffer instead of per byte. Elsewhere, the bytes are still
+// stored one at a time.
+//
+// As with EEPROMPrint, this does not perform any initialization of the
+// EEPROM. Any buffered data is flushed when this object is destroyed.
+class BufferedEEPROMPrint : public Print {
+ public:
+  // Creates a new buffered printer for the EEPROM. The buffer must remain
+  // valid for the lifetime of this object. A null or zero-size buffer means
+  // that every byte is written immediately.
+  BufferedEEPROMPrint(size_t size, int start, uint8_t *buf, size_t bufSize)
+      : size_(size),
+        buf_(buf),
+        bufSize_((buf == nullptr) ? 0 : bufSize),
+        count_(0) {
+    if (start < 0) {
+      start = 0;
+    }
+    start_ = start;
+    address_ = start;
+  }
+
+  ~BufferedEEPROMPrint() {
+    flushBuffer();
+  }
+
+  // Writes a byte to the buffer. This sets a write error if the EEPROM could
+  // not hold the byte.
+  size_t write(uint8_t b) override;
+
+  // Writes bytes to the buffer. This sets a write error if the EEPROM could
+  // not hold all the bytes.
+  size_t write(const uint8_t *buffer, size_t size) override;
+
+  // Stores any buffered bytes in the EEPROM.
+#if !defined(ESP8266) && !defined(ESP32) && !defined(ARDUINO_ARCH_STM32)
+  void flush() override {
+    flushBuffer();
+  }
+#else
+  void flush() {
+    flushBuffer();
+  }
+#endif
+
+  // Stores any buffered bytes and then resets the stream back to
+  // the beginning.
+  void reset() {
+    flushBuffer();
+    address_ = start_;
+  }
+
+  // Returns the current address. This indicates how many bytes were written,
+  // including any that are still buffered.
+  int getAddress() const {
+    return address_;
+  }
+
+ private:
+  // Stores the buffered bytes in the EEPROM.
+  void flushBuffer();
+
+  const size_t size_;
+  int start_;
+  int address_;
+
+  uint8_t *buf_;
+  const size_t bufSize_;
+  size_t count_;  // Number of buffered bytes, ending at address_
+};
+
 }  // namespace cbor
 }  // namespace qindesign
 
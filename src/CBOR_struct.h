@@ -0,0 +1,321 @@
+// CBOR_struct.h contains templates for encoding and decoding structures
+// whose fields are declared once, at compile time.
+// This is part of libCBOR.
+// (c) 2017 Shawn Silverman
+
+#ifndef CBOR_STRUCT_H_
+#define CBOR_STRUCT_H_
+
+// C++ includes
+#ifdef __has_include
+#if __has_include(<cstddef>)
+#include <cstddef>
+#else
+#include <stddef.h>
+#endif
+#if __has_include(<cstdint>)
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+#else
+#include <cstddef>
+#include <cstdint>
+#endif
+
+// Project includes
+#include "CBOR.h"
+#include "CBOR_parsing.h"
+
+// Declares a structure field for use in an ArraySchema or MapSchema. The key
+// is the unsigned integer map key; it's ignored for arrays.
+#define QINDESIGN_CBOR_FIELD(Type, member, key) \
+  ::qindesign::cbor::Field<Type, decltype(Type::member), &Type::member, (key)>
+
+namespace qindesign {
+namespace cbor {
+
+// Schemas describe how a structure is encoded. To give a structure a schema,
+// specialize this template and derive from ArraySchema or MapSchema with the
+// list of fields. For example:
+//
+//   struct Config {
+//     bool enabled;
+//     uint16_t interval;
+//     float gain;
+//   };
+//
+//   namespace qindesign {
+//   namespace cbor {
+//   template <>
+//   struct Schema<Config> : MapSchema<
+//       QINDESIGN_CBOR_FIELD(Config, enabled, 1),
+//       QINDESIGN_CBOR_FIELD(Config, interval, 2),
+//       QINDESIGN_CBOR_FIELD(Config, gain, 3)> {};
+//   }  // namespace cbor
+//   }  // namespace qindesign
+//
+// The structure can then be used with writeStruct and readStruct. All the
+// encoding and decoding calls are generated at compile time; there's no
+// runtime description of the fields.
+//
+// Supported field types are bool, the integer types other than plain char,
+// float, double, other structures having a schema, uint8_t arrays, which are
+// encoded as bytes having the array's length, and arrays of any other
+// supported type, which are encoded as CBOR arrays having the array's length.
+template <typename T>
+struct Schema;
+
+// Writes a structure that has a Schema.
+template <typename T>
+void writeStruct(Writer &w, const T &obj) {
+  Schema<T>::write(w, obj);
+}
+
+// Reads a structure that has a Schema. This returns false if the data does
+// not exactly match the schema, including the field order, or if an integer
+// doesn't fit into its field. The structure may be partially filled in if
+// this returns false.
+template <typename T>
+bool readStruct(Reader &r, T *obj) {
+  return Schema<T>::read(r, obj);
+}
+
+// ***************************************************************************
+//  Field value encoding and decoding.
+// ***************************************************************************
+
+namespace detail {
+
+// Reads an unsigned integer that fits into the given type.
+template <typename T>
+bool readUnsigned(Reader &r, T *v) {
+  uint64_t u;
+  if (!expectUnsignedInt(r, &u) || u > static_cast<T>(~T{0})) {
+    return false;
+  }
+  *v = static_cast<T>(u);
+  return true;
+}
+
+// Reads a signed integer that fits into the given type.
+template <typename T>
+bool readSigned(Reader &r, T *v) {
+  constexpr int64_t kMax =
+      static_cast<int64_t>(~0ULL >> (64 - 8*sizeof(T) + 1));
+  int64_t i;
+  if (!expectInt(r, &i)) {
+    return false;
+  }
+  if (r.isUnsigned() ? (i < 0 || i > kMax)
+                     : (r.isNegativeOverflow() || i < -kMax - 1)) {
+    return false;
+  }
+  *v = static_cast<T>(i);
+  return true;
+}
+
+// Reads a floating-point value of any precision, so that doubles written
+// with Writer::setShortestFloats() still round-trip.
+inline bool readAnyFloat(Reader &r, double *v) {
+  DataType dt = r.readDataType();
+  if (dt != DataType::kFloat && dt != DataType::kDouble) {
+    return false;
+  }
+  *v = r.getDouble();
+  return true;
+}
+
+}  // namespace detail
+
+inline void writeValue(Writer &w, bool v) { w.writeBoolean(v); }
+inline void writeValue(Writer &w, float v) { w.writeFloat(v); }
+inline void writeValue(Writer &w, double v) { w.writeDouble(v); }
+inline void writeValue(Writer &w, unsigned char v) { w.writeUnsignedInt(v); }
+inline void writeValue(Writer &w, unsigned short v) { w.writeUnsignedInt(v); }
+inline void writeValue(Writer &w, unsigned int v) { w.writeUnsignedInt(v); }
+inline void writeValue(Writer &w, unsigned long v) { w.writeUnsignedInt(v); }
+inline void writeValue(Writer &w, unsigned long long v) {
+  w.writeUnsignedInt(v);
+}
+inline void writeValue(Writer &w, signed char v) { w.writeInt(v); }
+inline void writeValue(Writer &w, short v) { w.writeInt(v); }
+inline void writeValue(Writer &w, int v) { w.writeInt(v); }
+inline void writeValue(Writer &w, long v) { w.writeInt(v); }
+inline void writeValue(Writer &w, long long v) { w.writeInt(v); }
+
+inline bool readValue(Reader &r, bool *v) { return expectBoolean(r, v); }
+inline bool readValue(Reader &r, float *v) { return expectFloat(r, v); }
+inline bool readValue(Reader &r, double *v) {
+  return detail::readAnyFloat(r, v);
+}
+inline bool readValue(Reader &r, unsigned char *v) {
+  return detail::readUnsigned(r, v);
+}
+inline bool readValue(Reader &r, unsigned short *v) {
+  return detail::readUnsigned(r, v);
+}
+inline bool readValue(Reader &r, unsigned int *v) {
+  return detail::readUnsigned(r, v);
+}
+inline bool readValue(Reader &r, unsigned long *v) {
+  return detail::readUnsigned(r, v);
+}
+inline bool readValue(Reader &r, unsigned long long *v) {
+  return detail::readUnsigned(r, v);
+}
+inline bool readValue(Reader &r, signed char *v) {
+  return detail::readSigned(r, v);
+}
+inline bool readValue(Reader &r, short *v) { return detail::readSigned(r, v); }
+inline bool readValue(Reader &r, int *v) { return detail::readSigned(r, v); }
+inline bool readValue(Reader &r, long *v) { return detail::readSigned(r, v); }
+inline bool readValue(Reader &r, long long *v) {
+  return detail::readSigned(r, v);
+}
+
+// Nested structures use their own schema.
+template <typename T>
+void writeValue(Writer &w, const T &v) {
+  Schema<T>::write(w, v);
+}
+
+template <typename T>
+bool readValue(Reader &r, T *v) {
+  return Schema<T>::read(r, v);
+}
+
+// Byte arrays are encoded as bytes having the array's length.
+template <size_t N>
+void writeValue(Writer &w, const uint8_t (&v)[N]) {
+  w.beginBytes(N);
+  w.writeBytes(v, N);
+}
+
+template <size_t N>
+bool readValue(Reader &r, uint8_t (*v)[N]) {
+  return expectBytesLength(r, N) && readFully(r, *v, N) == N;
+}
+
+// Other arrays are encoded as CBOR arrays having the array's length.
+template <typename E, size_t N>
+void writeValue(Writer &w, const E (&v)[N]) {
+  w.beginArray(N);
+  for (size_t i = 0; i < N; i++) {
+    writeValue(w, v[i]);
+  }
+}
+
+template <typename E, size_t N>
+bool readValue(Reader &r, E (*v)[N]) {
+  if (!expectArrayLength(r, N)) {
+    return false;
+  }
+  for (size_t i = 0; i < N; i++) {
+    if (!readValue(r, &(*v)[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// ***************************************************************************
+//  Fields and schemas.
+// ***************************************************************************
+
+// A single structure field. The QINDESIGN_CBOR_FIELD macro is an easier way
+// to declare one of these.
+template <typename T, typename M, M T::*Member, uint64_t Key>
+struct Field {
+  static constexpr uint64_t kKey = Key;
+
+  static void write(Writer &w, const T &obj) {
+    writeValue(w, obj.*Member);
+  }
+
+  static bool read(Reader &r, T *obj) {
+    return readValue(r, &(obj->*Member));
+  }
+};
+
+namespace detail {
+
+// Unrolls the encoding and decoding of a list of fields.
+template <typename... Fs>
+struct FieldList;
+
+template <>
+struct FieldList<> {
+  template <bool Keyed, typename T>
+  static void write(Writer &w, const T &obj) {}
+
+  template <bool Keyed, typename T>
+  static bool read(Reader &r, T *obj) {
+    return true;
+  }
+};
+
+template <typename F, typename... Rest>
+struct FieldList<F, Rest...> {
+  template <bool Keyed, typename T>
+  static void write(Writer &w, const T &obj) {
+    if (Keyed) {
+      w.writeUnsignedInt(F::kKey);
+    }
+    F::write(w, obj);
+    FieldList<Rest...>::template write<Keyed>(w, obj);
+  }
+
+  template <bool Keyed, typename T>
+  static bool read(Reader &r, T *obj) {
+    if (Keyed && !expectUnsignedIntValue(r, F::kKey)) {
+      return false;
+    }
+    return F::read(r, obj) && FieldList<Rest...>::template read<Keyed>(r, obj);
+  }
+};
+
+}  // namespace detail
+
+// Encodes a structure as a definite-length array of its field values, in
+// the order given. Field keys are ignored.
+template <typename... Fs>
+struct ArraySchema {
+  static constexpr size_t kLength = sizeof...(Fs);
+
+  template <typename T>
+  static void write(Writer &w, const T &obj) {
+    w.beginArray(kLength);
+    detail::FieldList<Fs...>::template write<false>(w, obj);
+  }
+
+  template <typename T>
+  static bool read(Reader &r, T *obj) {
+    return expectArrayLength(r, kLength) &&
+           detail::FieldList<Fs...>::template read<false>(r, obj);
+  }
+};
+
+// Encodes a structure as a definite-length map from each field's unsigned
+// integer key to its value, in the order given.
+template <typename... Fs>
+struct MapSchema {
+  static constexpr size_t kLength = sizeof...(Fs);
+
+  template <typename T>
+  static void write(Writer &w, const T &obj) {
+    w.beginMap(kLength);
+    detail::FieldList<Fs...>::template write<true>(w, obj);
+  }
+
+  template <typename T>
+  static bool read(Reader &r, T *obj) {
+    return expectMapLength(r, kLength) &&
+           detail::FieldList<Fs...>::template read<true>(r, obj);
+  }
+};
+
+}  // namespace cbor
+}  // namespace qindesign
+
+#endif  // CBOR_STRUCT_H_
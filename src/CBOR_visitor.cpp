@@ -0,0 +1,179 @@
+// CBOR_visitor.cpp is part of libCBOR.
+// (c) 2017 Shawn Silverman
+
+#include "CBOR_visitor.h"
+
+// Project includes
+#include "CBOR_nesting.h"
+
+namespace qindesign {
+namespace cbor {
+
+using detail::NestingStack;
+
+// Sends the contents of the current definite-length bytes or text to the
+// visitor in chunks. This returns false if end-of-stream was reached.
+static bool readString(Reader &r, Visitor &v, bool isText, uint8_t *buf,
+                       size_t bufSize) {
+  while (r.bytesAvailable() > 0) {
+    if (buf == nullptr || bufSize == 0) {
+      if (r.skip(r.bytesAvailable()) == 0) {
+        return false;
+      }
+      continue;
+    }
+    size_t read = r.readBytes(buf, bufSize);
+    if (read == 0) {
+      return false;
+    }
+    if (isText) {
+      v.onText(buf, read);
+    } else {
+      v.onBytes(buf, read);
+    }
+  }
+  return true;
+}
+
+// Parses the chunks of an indefinite-length string, after its initial data
+// item, up to and including the break.
+static WellFormedError parseIndefiniteString(Reader &r, Visitor &v,
+                                             DataType type, uint8_t *buf,
+                                             size_t bufSize) {
+  while (true) {
+    DataType dt = r.readDataType();
+    if (dt == DataType::kBreak) {
+      return WellFormedError::kNoError;
+    }
+    if (dt == DataType::kEOS) {
+      return WellFormedError::kEOS;
+    }
+    if (dt != type || r.isIndefiniteLength()) {
+      return WellFormedError::kSyntaxError;
+    }
+    if (!readString(r, v, type == DataType::kText, buf, bufSize)) {
+      return WellFormedError::kEOS;
+    }
+  }
+}
+
+WellFormedError parse(Reader &r, Visitor &v, uint8_t *buf, size_t bufSize,
+                      int maxDepth) {
+  if (maxDepth > kMaxDepth) {
+    maxDepth = kMaxDepth;
+  }
+
+  NestingStack stack;
+
+  while (true) {
+    DataType dt = r.readDataType();
+    switch (dt) {
+      case DataType::kUnsignedInt:
+        v.onUInt(r.getUnsignedInt());
+        break;
+      case DataType::kNegativeInt:
+        v.onNegInt(r.getRawValue());
+        break;
+
+      case DataType::kBytes:
+      case DataType::kText: {
+        bool isText = (dt == DataType::kText);
+        bool indefinite = r.isIndefiniteLength();
+        uint64_t length = indefinite ? 0 : r.getLength();
+        if (isText) {
+          v.onBeginText(length, indefinite);
+        } else {
+          v.onBeginBytes(length, indefinite);
+        }
+        if (indefinite) {
+          WellFormedError err = parseIndefiniteString(r, v, dt, buf, bufSize);
+          if (err != WellFormedError::kNoError) {
+            return err;
+          }
+        } else if (!readString(r, v, isText, buf, bufSize)) {
+          return WellFormedError::kEOS;
+        }
+        if (isText) {
+          v.onEndText();
+        } else {
+          v.onEndBytes();
+        }
+        break;
+      }
+
+      case DataType::kArray:
+      case DataType::kMap: {
+        bool isMap = (dt == DataType::kMap);
+        bool indefinite = r.isIndefiniteLength();
+        uint64_t length = indefinite ? 0 : r.getLength();
+        uint64_t count = length;
+        if (isMap && !detail::mapItemCount(length, &count)) {
+          return WellFormedError::kSyntaxError;
+        }
+        bool empty = !indefinite && count == 0;
+        if (!empty && !stack.begin(count, indefinite, isMap, maxDepth)) {
+          return WellFormedError::kMaxDepthExceeded;
+        }
+        if (isMap) {
+          v.onBeginMap(length, indefinite);
+        } else {
+          v.onBeginArray(length, indefinite);
+        }
+        if (empty) {
+          v.onEnd();
+          break;
+        }
+        continue;
+      }
+
+      case DataType::kTag:
+        v.onTag(r.getTag());
+        stack.setTagged(true);
+        continue;
+
+      case DataType::kBoolean:
+        v.onBoolean(r.getBoolean());
+        break;
+      case DataType::kNull:
+        v.onNull();
+        break;
+      case DataType::kUndefined:
+        v.onUndefined();
+        break;
+      case DataType::kSimpleValue:
+        v.onSimpleValue(r.getSimpleValue());
+        break;
+      case DataType::kFloat:
+        v.onFloat(r.getFloat());
+        break;
+      case DataType::kDouble:
+        v.onDouble(r.getDouble());
+        break;
+
+      case DataType::kBreak:
+        if (!stack.endBreak()) {
+          return WellFormedError::kSyntaxError;
+        }
+        v.onEnd();
+        break;
+
+      case DataType::kEOS:
+        return WellFormedError::kEOS;
+      case DataType::kSyntaxError:
+      default:
+        return WellFormedError::kSyntaxError;
+    }
+
+    // An item is complete, so count it against the enclosing containers,
+    // ending any definite-length containers that are now complete
+    for (int ended = stack.endItem(); ended > 0; ended--) {
+      v.onEnd();
+    }
+    if (stack.depth() == 0) {
+      return WellFormedError::kNoError;
+    }
+  }
+}
+
+}  // namespace cbor
+}  // namespace qindesign
@@ -0,0 +1,125 @@
+// CBOR_visitor.h defines the interface for receiving data items as a series
+// of events.
+// This is part of libCBOR.
+// (c) 2017 Shawn Silverman
+
+#ifndef CBOR_VISITOR_H_
+#define CBOR_VISITOR_H_
+
+// C++ includes
+#ifdef __has_include
+#if __has_include(<cstddef>)
+#include <cstddef>
+#else
+#include <stddef.h>
+#endif
+#if __has_include(<cstdint>)
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+#else
+#include <cstddef>
+#include <cstdint>
+#endif
+
+// Project includes
+#include "CBOR.h"
+
+namespace qindesign {
+namespace cbor {
+
+// Visitor receives parsed data items as events. Subclasses override the
+// functions for the events they're interested in; the defaults do nothing.
+//
+// Bytes and text are delivered as a begin event, zero or more chunks, and an
+// end event. For indefinite-length strings, the chunks are the contents of
+// each definite-length part, possibly split further, and the parts
+// themselves are not reported. Note that text chunks may split a
+// multi-byte UTF-8 sequence.
+//
+// Arrays and maps are delivered as a begin event, their items, and an
+// onEnd() event, for both definite and indefinite lengths. Map items
+// alternate between keys and values.
+//
+// A tag event applies to the data item that follows it.
+class Visitor {
+ public:
+  virtual ~Visitor() = default;
+
+  // An unsigned integer.
+  virtual void onUInt(uint64_t u) {}
+
+  // A negative integer having the value -1 - u. This can represent all
+  // CBOR negative integers, including those that don't fit into an int64_t.
+  virtual void onNegInt(uint64_t u) {}
+
+  // The start of a byte string. For indefinite-length bytes, length will be
+  // zero.
+  virtual void onBeginBytes(uint64_t length, bool isIndefinite) {}
+
+  // A chunk of byte string data. The data is only valid during the call.
+  virtual void onBytes(const uint8_t *chunk, size_t length) {}
+
+  // The end of a byte string.
+  virtual void onEndBytes() {}
+
+  // The start of a text string. For indefinite-length text, length will be
+  // zero.
+  virtual void onBeginText(uint64_t length, bool isIndefinite) {}
+
+  // A chunk of text string data. The data is only valid during the call.
+  virtual void onText(const uint8_t *chunk, size_t length) {}
+
+  // The end of a text string.
+  virtual void onEndText() {}
+
+  // The start of an array. For indefinite-length arrays, length will be
+  // zero.
+  virtual void onBeginArray(uint64_t length, bool isIndefinite) {}
+
+  // The start of a map. The length is the number of key/value pairs. For
+  // indefinite-length maps, length will be zero.
+  virtual void onBeginMap(uint64_t length, bool isIndefinite) {}
+
+  // The end of the current array or map.
+  virtual void onEnd() {}
+
+  // A tag for the next data item.
+  virtual void onTag(uint64_t tag) {}
+
+  virtual void onBoolean(bool b) {}
+  virtual void onNull() {}
+  virtual void onUndefined() {}
+
+  // A simple value other than boolean, null, or undefined.
+  virtual void onSimpleValue(uint8_t v) {}
+
+  // A half- or single-precision floating-point value.
+  virtual void onFloat(float f) {}
+
+  // A double-precision floating-point value.
+  virtual void onDouble(double d) {}
+};
+
+// Parses the next complete data item from the reader, sending its events to
+// the visitor. Nested arrays, maps, and tags are handled iteratively, up to
+// maxDepth levels of nesting, which is limited to kMaxDepth.
+//
+// Bytes and text contents are read into buf and delivered in chunks of up to
+// bufSize bytes. If buf is null or bufSize is zero, the contents are skipped
+// and only the begin and end events are sent.
+//
+// This returns WellFormedError::kNoError if the item was parsed successfully
+// and the reason otherwise. The visitor may have received some events for
+// an item that turns out not to be well-formed. Like
+// Reader::isWellFormed(), this treats end-of-stream partway through the item
+// as an error, so for streams that may not have all the data yet, consider
+// using a PushParser instead.
+WellFormedError parse(Reader &r, Visitor &v, uint8_t *buf, size_t bufSize,
+                      int maxDepth = kMaxDepth);
+
+}  // namespace cbor
+}  // namespace qindesign
+
+#endif  // CBOR_VISITOR_H_
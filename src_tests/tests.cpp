@@ -23,11 +23,20 @@
 // Other includes
 #include <Arduino.h>
 #include <ArduinoUnit.h>
+#include <EEPROM.h>
 
 // Project includes
 #include "CBOR.h"
+#include "CBOR_document.h"
+#include "CBOR_index.h"
+#include "CBOR_packed.h"
 #include "CBOR_parsing.h"
+#include "CBOR_pool.h"
+#include "CBOR_push.h"
+#include "CBOR_sequence.h"
 #include "CBOR_streams.h"
+#include "CBOR_struct.h"
+#include "CBOR_visitor.h"
 
 namespace cbor = ::qindesign::cbor;
 
@@ -46,6 +55,22 @@ namespace cbor = ::qindesign::cbor;
 #include "tests/api.inc"
 #include "tests/parsing.inc"
 #include "tests/int.inc"
+#include "tests/buffer_reader.inc"
+#include "tests/skip.inc"
+#include "tests/index.inc"
+#include "tests/struct.inc"
+#include "tests/size.inc"
+#include "tests/typed_array.inc"
+#include "tests/push.inc"
+#include "tests/visitor.inc"
+#include "tests/document.inc"
+#include "tests/stats.inc"
+#include "tests/pool.inc"
+#include "tests/ring_buffer.inc"
+#include "tests/eeprom.inc"
+#include "tests/flash.inc"
+#include "tests/sequence.inc"
+#include "tests/packed.inc"
 
 // ***************************************************************************
 //  Main program